@@ -0,0 +1,197 @@
+# benchmarks/checks.py
+# run.py --check 额外运行的行为检查。每个检查在一个全新的临时数据库上复现一个出过的问题，
+# 返回问题描述的列表，空列表表示通过。全部在 run.py 启动的单独子进程里运行，
+# 会改动 todo.db 的模块级状态（数据库位置、缓存、观察者）。
+#
+#   python benchmarks/run.py --check            # 查询计划、启动导入和这里的检查
+#   python benchmarks/checks.py                 # 只运行这里的检查
+
+import os
+import sys
+import tempfile
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT)
+
+CHECKS = {}
+
+
+def check(func):
+    CHECKS[func.__name__] = func
+    return func
+
+class _Abort(Exception):
+    """检查里用来触发回滚的异常"""
+
+
+def _fresh_db(path=None):
+    """关闭现有连接，换到一个新的空数据库，清掉缓存和观察者；path 为 None 时在临时目录里新建文件"""
+    from todo import db
+    db.close_db()
+    for observer in list(db._observers):
+        db.remove_observer(observer)
+    db._task_cache = None
+    db._result_cache = None
+    db.QUIET = True
+    db.DATABASE_PATH = path or os.path.join(tempfile.mkdtemp(prefix='todo-check-'), 'todo.db')
+    return db
+
+def _table_ids(db):
+    return [row[0] for row in db.get_db().execute(
+        "SELECT task_id FROM todo ORDER BY created_at DESC, task_id DESC;")]
+
+
+@check
+def rollback_keeps_task_cache_consistent():
+    """回滚的写操作不能留在任务缓存里（整个事务回滚、嵌套的 SAVEPOINT 回滚）"""
+    db = _fresh_db()
+    db.enable_task_cache()
+    db.add_todo('kept')
+    db.get_all_todos()
+    problems = []
+
+    try:
+        with db.transaction():
+            db.add_todo('rolled back')
+            raise _Abort
+    except _Abort:
+        pass
+    cached = [task.task_id for task in db.get_all_todos()]
+    if cached != _table_ids(db) or db.count_todos() != len(cached):
+        problems.append(f"事务回滚后缓存 {cached}，表中 {_table_ids(db)}，count_todos {db.count_todos()}")
+
+    with db.transaction():
+        db.add_todo('outer')
+        try:
+            with db.transaction():
+                db.add_todo('inner rolled back')
+                raise _Abort
+        except _Abort:
+            pass
+    cached = [task.task_id for task in db.get_all_todos()]
+    if cached != _table_ids(db):
+        problems.append(f"SAVEPOINT 回滚后缓存 {cached}，表中 {_table_ids(db)}")
+    return problems
+
+
+@check
+def memory_reads_during_write():
+    """内存模式下，另一个线程的写事务进行中，读操作等它提交，不会因为表级锁直接失败"""
+    import threading
+    import time
+    db = _fresh_db(path=':memory:')
+    db.add_todo('first')
+    problems = []
+    in_transaction = threading.Event()
+
+    def write():
+        with db.transaction():
+            db.add_todo('second')
+            in_transaction.set()
+            time.sleep(0.2)
+        db.release_db()
+
+    def read():
+        in_transaction.wait()
+        try:
+            count = db.count_todos()
+            tasks = db.find_todos(status=0)
+            if count != len(tasks) or count not in (1, 2):
+                problems.append(f"读到的数量不一致：count_todos {count}，find_todos {len(tasks)}")
+        except Exception as e:
+            problems.append(f"写事务进行中读取失败：{type(e).__name__}: {e}")
+        finally:
+            db.release_db()
+
+    threads = [threading.Thread(target=write), threading.Thread(target=read)]
+    for thread in threads:
+        thread.start()
+    for thread in threads:
+        thread.join()
+    if db.count_todos() != 2:
+        problems.append(f"写事务提交后 count_todos 为 {db.count_todos()}")
+    db.close_db()
+    return problems
+
+
+@check
+def instrument_records_iterated_cursors():
+    """直接遍历游标、或者从不取结果的语句也要出现在统计里，行数按实际取到的计算"""
+    from todo import instrument
+    db = _fresh_db()
+    db.add_todos([('a', None), ('b', None), ('c', None)])
+    db.close_db()
+    instrument.enable()
+    instrument.reset()
+    problems = []
+    try:
+        conn = db.get_db()
+        iterated = "SELECT task_id FROM todo ORDER BY task_id;"
+        unfetched = "SELECT content FROM todo ORDER BY task_id;"
+        seen = sum(1 for _ in conn.execute(iterated))
+        pending = conn.execute(unfetched)
+        recorded = {item['sql']: item for item in instrument.summary(limit=None)['statements']}
+        if iterated not in recorded:
+            problems.append("遍历游标的语句没有被记录")
+        elif recorded[iterated]['rows'] != seen:
+            problems.append(f"遍历游标记录了 {recorded[iterated]['rows']} 行，实际取到 {seen} 行")
+        if unfetched not in recorded:
+            problems.append("没有取结果的语句在生成摘要时没有被记录")
+        pending.close()
+    finally:
+        instrument.ENABLED = False
+        db.close_db()
+    return problems
+
+
+@check
+def sync_refuses_pruned_since():
+    """清理过变更日志后，从被清理的序号增量导出要报错；--since 0 仍然导出全部任务"""
+    db = _fresh_db()
+    db.add_todos([('a', None), ('b', None), ('c', None)])
+    ids = _table_ids(db)
+    db.delete_todo(ids[1])
+    floor = db.last_change()
+    db.prune_changes(floor + 1000)
+    db.edit_todo(ids[0], content='a2')
+    problems = []
+    if db.changes_floor() != floor:
+        problems.append(f"清理到的序号记为 {db.changes_floor()}，应为当时已有的最大序号 {floor}")
+    try:
+        db.iter_changes(floor - 1)
+        problems.append("since 小于清理到的序号时没有报错")
+    except ValueError:
+        pass
+    after = [task_id for batch in db.iter_changes(floor) for _, task_id, _, _ in batch]
+    if after != [ids[0]]:
+        problems.append(f"从清理到的序号增量导出得到 {after}，应为 {[ids[0]]}")
+    full = {task_id: kind for batch in db.iter_changes(0) for _, task_id, kind, _ in batch}
+    expected = {task_id: db.CHANGE_UPSERT for task_id in _table_ids(db)}
+    if full != expected:
+        problems.append(f"--since 0 导出了 {full}，应为 {expected}")
+    db.close_db()
+    return problems
+
+
+def run_checks():
+    """运行全部检查，返回 {检查名: 问题列表}"""
+    report = {}
+    for name, func in CHECKS.items():
+        try:
+            report[name] = func()
+        except Exception as e:
+            report[name] = [f"{type(e).__name__}: {e}"]
+    return report
+
+def main():
+    failed = False
+    for name, problems in run_checks().items():
+        print(f"{'FAIL' if problems else 'ok  '} {name}")
+        for problem in problems:
+            failed = True
+            print(f"     {problem}")
+    return 1 if failed else 0
+
+
+if __name__ == '__main__':
+    raise SystemExit(main())
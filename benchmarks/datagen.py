@@ -0,0 +1,53 @@
+# benchmarks/datagen.py
+# 生成合成数据：已完成/未完成、有无截止日期、中英文内容按接近真实使用的比例混合
+
+import random
+from datetime import datetime, timedelta
+
+TIME_FORMAT = '%Y-%m-%d %H:%M:%S'
+
+# 大约 60% 的任务已经完成，40% 带截止日期，30% 的内容是英文
+DONE_RATIO = 0.6
+DEADLINE_RATIO = 0.4
+ASCII_RATIO = 0.3
+# 创建时间分布在过去两年内，截止日期在前后 90 天内
+CREATED_SPAN_DAYS = 730
+DEADLINE_SPAN_DAYS = 90
+
+CJK_VERBS = ['写', '整理', '提交', '检查', '回复', '准备', '修改', '讨论', '预约', '购买']
+CJK_NOUNS = ['周报', '会议纪要', '季度预算', '代码评审', '客户邮件', '体检', '机票', '房租', '论文初稿', '项目计划']
+CJK_EXTRAS = ['', '给老板', '（紧急）', '并发群里', '，别忘了带附件', '和同事一起']
+ASCII_VERBS = ['write', 'review', 'fix', 'deploy', 'email', 'call', 'refactor', 'book', 'update', 'plan']
+ASCII_NOUNS = ['weekly report', 'release notes', 'login bug', 'staging server', 'dentist', 'budget sheet',
+               'flight tickets', 'design doc', 'ops runbook', 'sprint backlog']
+TAGS = ['', '', '', ' #ops', ' #home', ' #work']
+
+
+def make_content(rng):
+    if rng.random() < ASCII_RATIO:
+        return f"{rng.choice(ASCII_VERBS)} {rng.choice(ASCII_NOUNS)}{rng.choice(TAGS)}"
+    return f"{rng.choice(CJK_VERBS)}{rng.choice(CJK_NOUNS)}{rng.choice(CJK_EXTRAS)}{rng.choice(TAGS)}"
+
+def generate_rows(count, seed=0, now=None):
+    """逐行产出 (content, is_done, created_at, deadline)，同一个 seed 得到同样的数据"""
+    rng = random.Random(seed)
+    now = now or datetime(2026, 1, 1)
+    for _ in range(count):
+        created_at = now - timedelta(seconds=rng.randrange(CREATED_SPAN_DAYS * 86400))
+        deadline = None
+        if rng.random() < DEADLINE_RATIO:
+            deadline = (now + timedelta(seconds=rng.randrange(-DEADLINE_SPAN_DAYS * 86400,
+                                                              DEADLINE_SPAN_DAYS * 86400))).strftime(TIME_FORMAT)
+        is_done = 1 if rng.random() < DONE_RATIO else 0
+        yield make_content(rng), is_done, created_at.strftime(TIME_FORMAT), deadline
+
+def populate(conn, count, seed=0, chunk_size=10000):
+    """把 count 个合成任务写入 conn 指向的数据库（表结构需已创建），单个事务完成"""
+    sql = "INSERT INTO todo (content, is_done, created_at, deadline) VALUES (?, ?, ?, ?);"
+    rows = generate_rows(count, seed)
+    with conn:
+        while True:
+            chunk = [row for _, row in zip(range(chunk_size), rows)]
+            if not chunk:
+                break
+            conn.executemany(sql, chunk)
@@ -0,0 +1,309 @@
+# benchmarks/run.py
+# todo.db 的基准测试。每个数据规模在独立的子进程里运行，互不影响缓存和内存。
+#
+#   python benchmarks/run.py                            # 默认 10k、100k
+#   python benchmarks/run.py --sizes 10000 100000 1000000 --output after.json
+#   python benchmarks/run.py --compare before.json after.json
+#   python benchmarks/run.py --check                    # 查询计划、启动导入退化或行为检查（checks.py）失败时返回非零
+#   python benchmarks/run.py --memory                   # 用内存数据库，排除磁盘与 fsync 的影响
+#
+# 结果是 JSON，包含提交号、Python 与 SQLite 版本，方便在不同提交之间比较。
+
+import argparse
+import json
+import os
+import platform
+import sqlite3
+import statistics
+import subprocess
+import sys
+import tempfile
+import time
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+sys.path.insert(0, ROOT)
+
+DEFAULT_SIZES = [10000, 100000]
+DEFAULT_REPEAT = 5
+# 单行写操作每轮执行的次数，结果按单次平均
+WRITE_CALLS = 200
+# 批量写操作每轮处理的行数
+BULK_ROWS = 10000
+
+# 这些查询必须走索引：计划里出现全表扫描或临时排序就算退化。
+# 名字 -> (调用方式, 是否允许临时排序)。全文搜索要按相关度排序，只能临时排序。
+# 少于 3 个字符的关键词会退回 LIKE：find_todos_like 只靠 is_done 索引缩小范围，逐行匹配。
+PLAN_SHAPES = {
+    'get_all_todos': (lambda db: db.get_all_todos(), False),
+    'get_todos_page': (lambda db: db.get_todos_page(50, after=('2026-01-01 00:00:00', 1)), False),
+    'find_todos_status': (lambda db: db.find_todos(status=0), False),
+    'find_todos_text': (lambda db: db.find_todos(status=0, text_search='会议纪要'), True),
+    'find_todos_like': (lambda db: db.find_todos(status=0, text_search='周报'), False),
+    'upcoming_deadlines': (lambda db: db.get_upcoming_deadlines('2026-01-01 00:00:00'), False),
+    'find_todos_due_window': (lambda db: db.find_todos(status=0, due_after='2026-01-01', due_before='2026-01-08'), False),
+    'find_todos_tag': (lambda db: db.find_todos(status=0, tags=['ops']), True),
+    'tag_counts': (lambda db: db.tag_counts(), False),
+    'find_todos_started': (lambda db: db.find_todos(due_before='2026-01-08', started=True, now='2026-01-01'), False),
+    'summary': (lambda db: db.summary('2026-01-01 00:00:00'), False),
+}
+
+# 计划里必须出现的步骤（前缀匹配），防止查询悄悄换成另一条同样不扫表的路径
+PLAN_REQUIRED = {
+    'find_todos_text': 'SCAN todo_fts VIRTUAL TABLE INDEX',
+}
+
+# 行数固定很少的表，全表扫描没有问题
+SMALL_TABLES = {'todo_stats', 'tag'}
+
+# `todo list --count` 启动时不应该导入的模块，出现即视为启动路径退化
+# （datetime 不在其中：sqlite3 模块自己就会导入它）
+STARTUP_FORBIDDEN = ['json', 'configparser', 'socket', 'socketserver', 'unicodedata',
+                     'importlib.resources', 'concurrent.futures', 'heapq', 'csv', 'gzip', 'random']
+
+
+def _timed(func, repeat):
+    """执行 repeat 轮，返回每轮耗时（毫秒）"""
+    samples = []
+    for _ in range(repeat):
+        start = time.perf_counter()
+        func()
+        samples.append((time.perf_counter() - start) * 1000)
+    return samples
+
+def _summary(samples, per=1):
+    return {
+        'min_ms': min(samples) / per,
+        'median_ms': statistics.median(samples) / per,
+        'mean_ms': statistics.fmean(samples) / per,
+        'rounds': len(samples),
+        'calls_per_round': per,
+    }
+
+def _explain(conn, sql):
+    return [row[3] for row in conn.execute("EXPLAIN QUERY PLAN " + sql)]
+
+def check_plans(db):
+    """执行 PLAN_SHAPES 中的每个调用，记录实际发出的 SQL 并检查其查询计划"""
+    conn = db.get_db()
+    report = {}
+    for name, (call, allow_sort) in PLAN_SHAPES.items():
+        statements = []
+        conn.set_trace_callback(statements.append)
+        try:
+            call(db)
+        finally:
+            conn.set_trace_callback(None)
+        plans = []
+        problems = []
+        for sql in statements:
+            # 以 -- 开头的是 FTS5 等内部发出的语句
+            if sql.startswith('--') or not sql.lstrip().upper().startswith('SELECT'):
+                continue
+            plan = _explain(conn, sql)
+            plans.append(plan)
+            for step in plan:
+                if step.startswith('SCAN ') and 'INDEX' not in step and step.split()[1] not in SMALL_TABLES:
+                    problems.append(step)
+                if 'TEMP B-TREE' in step and not allow_sort:
+                    problems.append(step)
+        required = PLAN_REQUIRED.get(name)
+        if required and not any(step.startswith(required) for plan in plans for step in plan):
+            problems.append(f"缺少 {required}")
+        report[name] = {'plans': plans, 'problems': problems}
+    return report
+
+def run_size(size, repeat, seed, memory=False):
+    """在当前进程里生成 size 行数据并运行所有基准，返回结果字典"""
+    from benchmarks import datagen
+    from todo import db
+
+    workdir = tempfile.mkdtemp(prefix='todo-bench-')
+    db.DATABASE_PATH = db.MEMORY_PATH if memory else os.path.join(workdir, 'todo.db')
+    db.QUIET = True
+    # 查询本身的耗时与计划在关闭结果缓存时测量，缓存命中单独计时
+    db._result_cache = False
+    db.init_db()
+
+    start = time.perf_counter()
+    datagen.populate(db.get_db(), size, seed)
+    results = {'populate_s': time.perf_counter() - start}
+    db.import_hashtags()
+
+    results['plans'] = check_plans(db)
+
+    reads = {
+        'get_all_todos': lambda: db.get_all_todos(),
+        'iter_todos': lambda: sum(1 for _ in db.iter_todos()),
+        'get_todos_page_50': lambda: db.get_todos_page(50),
+        'count_todos_open': lambda: db.count_todos(0),
+        'summary': lambda: db.summary('2026-01-01 00:00:00'),
+        'find_todos_status_open': lambda: db.find_todos(status=0),
+        'find_todos_text_fts': lambda: db.find_todos(text_search='周报给'),
+        'find_todos_text_like': lambda: db.find_todos(text_search='周报'),
+        'find_todos_tag_open': lambda: db.find_todos(status=0, tags=['ops']),
+        'tag_counts': lambda: db.tag_counts(),
+    }
+    from todo import transfer
+    for fmt in ('jsonl', 'csv'):
+        reads[f'export_{fmt}'] = lambda fmt=fmt: transfer.export(
+            os.path.join(workdir, 'export.' + fmt), fmt, db.EXPORT_COLUMNS, db.iter_export_batches())
+    timings = {}
+    for name, func in reads.items():
+        timings[name] = _summary(_timed(func, repeat))
+
+    db._result_cache = None
+    cached = {
+        'cached_get_all_todos': lambda: db.get_all_todos(),
+        'cached_find_todos_status_open': lambda: db.find_todos(status=0),
+        'cached_count_todos_open': lambda: db.count_todos(0),
+    }
+    for name, func in cached.items():
+        func()
+        timings[name] = _summary(_timed(lambda: [func() for _ in range(WRITE_CALLS)], repeat), WRITE_CALLS)
+    db._result_cache = False
+
+    rows = list(datagen.generate_rows(BULK_ROWS, seed + 1))
+    ids = [task_id for (task_id,) in db.get_db().execute(
+        "SELECT task_id FROM todo ORDER BY task_id LIMIT ?;", (WRITE_CALLS,))]
+
+    def add_single():
+        for content, _, _, deadline in rows[:WRITE_CALLS]:
+            db.add_todo(content, deadline)
+
+    def edit_single():
+        for task_id in ids:
+            db.edit_todo(task_id, content='benchmark edit', deadline='2026-06-01 00:00:00')
+
+    timings['add_todo'] = _summary(_timed(add_single, repeat), WRITE_CALLS)
+    timings['edit_todo'] = _summary(_timed(edit_single, repeat), WRITE_CALLS)
+    timings['add_todos_bulk'] = _summary(
+        _timed(lambda: db.add_todos((content, deadline) for content, _, _, deadline in rows), repeat), BULK_ROWS)
+    bulk_ids = [task_id for (task_id,) in db.get_db().execute(
+        "SELECT task_id FROM todo ORDER BY task_id LIMIT ?;", (BULK_ROWS,))]
+    timings['set_status_many'] = _summary(_timed(lambda: db.set_status_many(bulk_ids, 1), repeat), len(bulk_ids))
+
+    results['timings'] = timings
+    db.close_db()
+    return results
+
+def check_startup():
+    """运行两次 `todo list --count`（第一次用来建库），检查第二次的导入情况"""
+    workdir = tempfile.mkdtemp(prefix='todo-startup-')
+    os.makedirs(os.path.join(workdir, 'data'))
+    env = dict(os.environ, PYTHONPATH=ROOT)
+    command = [sys.executable, '-X', 'importtime', '-m', 'todo', 'list', '--count']
+    subprocess.run(command, cwd=workdir, env=env, capture_output=True, check=True)
+    start = time.perf_counter()
+    proc = subprocess.run(command, cwd=workdir, env=env, capture_output=True, text=True, check=True)
+    wall_ms = (time.perf_counter() - start) * 1000
+
+    imported = {}
+    for line in proc.stderr.splitlines():
+        if not line.startswith('import time:') or 'imported package' in line:
+            continue
+        parts = line.split('|')
+        if len(parts) == 3 and parts[1].strip().isdigit():
+            imported[parts[2].strip()] = int(parts[1].strip())
+    todo_us = sum(us for name, us in imported.items() if name in ('todo', 'todo.cli'))
+    forbidden = [name for name in STARTUP_FORBIDDEN if name in imported]
+    return {'wall_ms': wall_ms, 'todo_import_us': todo_us, 'modules': len(imported), 'forbidden': forbidden}
+
+def _metadata():
+    try:
+        commit = subprocess.run(['git', 'rev-parse', '--short', 'HEAD'], cwd=ROOT,
+                                capture_output=True, text=True).stdout.strip() or None
+    except OSError:
+        commit = None
+    return {
+        'commit': commit,
+        'python': platform.python_version(),
+        'sqlite': sqlite3.sqlite_version,
+        'platform': platform.platform(),
+        'timestamp': time.strftime('%Y-%m-%dT%H:%M:%S'),
+    }
+
+def compare(before_path, after_path):
+    """打印两份结果中各项 median 的变化"""
+    with open(before_path, encoding='utf-8') as f:
+        before = json.load(f)
+    with open(after_path, encoding='utf-8') as f:
+        after = json.load(f)
+    print(f"{'size':>8}  {'benchmark':<24} {'before':>10} {'after':>10} {'ratio':>7}")
+    for size, result in after['sizes'].items():
+        old = before['sizes'].get(size)
+        if old is None:
+            continue
+        for name, timing in result['timings'].items():
+            if name not in old['timings']:
+                continue
+            a = old['timings'][name]['median_ms']
+            b = timing['median_ms']
+            print(f"{size:>8}  {name:<24} {a:>10.4f} {b:>10.4f} {b / a if a else float('inf'):>6.2f}x")
+
+def main():
+    parser = argparse.ArgumentParser(description='todo.db 基准测试')
+    parser.add_argument('--sizes', type=int, nargs='+', default=DEFAULT_SIZES, help='数据规模（行数）')
+    parser.add_argument('--repeat', type=int, default=DEFAULT_REPEAT, help='每项重复的轮数')
+    parser.add_argument('--seed', type=int, default=0, help='数据生成的随机种子')
+    parser.add_argument('--output', help='结果写入的 JSON 文件，默认输出到标准输出')
+    parser.add_argument('--check', action='store_true', help='查询计划或启动导入退化时以非零状态退出')
+    parser.add_argument('--memory', action='store_true', help='使用内存数据库')
+    parser.add_argument('--compare', nargs=2, metavar=('BEFORE', 'AFTER'), help='比较两份结果')
+    parser.add_argument('--worker', type=int, help=argparse.SUPPRESS)
+    parser.add_argument('--checks-worker', action='store_true', help=argparse.SUPPRESS)
+    args = parser.parse_args()
+
+    if args.compare:
+        compare(*args.compare)
+        return 0
+
+    if args.checks_worker:
+        from benchmarks import checks
+        json.dump(checks.run_checks(), sys.stdout, ensure_ascii=False)
+        return 0
+
+    if args.worker is not None:
+        json.dump(run_size(args.worker, args.repeat, args.seed, args.memory), sys.stdout)
+        return 0
+
+    meta = dict(_metadata(), storage='memory' if args.memory else 'file')
+    report = {'meta': meta, 'startup': check_startup(), 'sizes': {}}
+    for size in args.sizes:
+        print(f"running {size} rows...", file=sys.stderr)
+        proc = subprocess.run(
+            [sys.executable, os.path.abspath(__file__), '--worker', str(size),
+             '--repeat', str(args.repeat), '--seed', str(args.seed)] + (['--memory'] if args.memory else []),
+            cwd=ROOT, capture_output=True, text=True, check=True)
+        report['sizes'][str(size)] = json.loads(proc.stdout)
+    if args.check:
+        proc = subprocess.run([sys.executable, os.path.abspath(__file__), '--checks-worker'],
+                              cwd=ROOT, capture_output=True, text=True, check=True)
+        report['checks'] = json.loads(proc.stdout)
+
+    text = json.dumps(report, ensure_ascii=False, indent=2)
+    if args.output:
+        with open(args.output, 'w', encoding='utf-8') as f:
+            f.write(text + '\n')
+    else:
+        print(text)
+
+    if args.check:
+        failed = False
+        for size, result in report['sizes'].items():
+            for name, plan in result['plans'].items():
+                if plan['problems']:
+                    failed = True
+                    print(f"[{size}] {name} 没有走索引: {plan['problems']}", file=sys.stderr)
+        for name, problems in report['checks'].items():
+            for problem in problems:
+                failed = True
+                print(f"行为检查 {name} 失败: {problem}", file=sys.stderr)
+        if report['startup']['forbidden']:
+            failed = True
+            print(f"todo list --count 启动时导入了: {report['startup']['forbidden']}", file=sys.stderr)
+        return 1 if failed else 0
+    return 0
+
+
+if __name__ == '__main__':
+    raise SystemExit(main())
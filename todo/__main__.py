@@ -1,10 +1,49 @@
-from . import ui
+import os
+import sys
+
+from . import cli
 from . import db
-def main():
-    print("欢迎使用 TodoList 应用！")
-    db.init_db()
-    ui.main_loop()
+
+# 下游提前关闭管道时（todo list | head -1）的退出码，与被 SIGPIPE 终止的进程一致：128 + 13
+EXIT_BROKEN_PIPE = 141
+
+
+def main(argv=None):
+    try:
+        return _run(argv)
+    except db.SQLiteVersionError as e:
+        print(f"错误：{e}", file=sys.stderr)
+        return 1
+    except BrokenPipeError:
+        # 读取端已经关闭，剩下的输出没人要了。把标准输出指向 /dev/null，
+        # 解释器退出时再 flush 缓冲区也不会又抛出一次 BrokenPipeError
+        devnull = os.open(os.devnull, os.O_WRONLY)
+        os.dup2(devnull, sys.stdout.fileno())
+        os.close(devnull)
+        return EXIT_BROKEN_PIPE
+
+def _run(argv):
+    args = cli.build_parser().parse_args(argv)
+    if args.profile:
+        # 要在打开数据库连接之前开启，见 tracing.py
+        from . import tracing
+        tracing.enable(args.profile)
+    if args.command is None:
+        # 只有交互模式才需要 ui
+        from . import ui
+        print("欢迎使用 TodoList 应用！")
+        db.init_db()
+        ui.main_loop(pause=0 if args.no_pause else ui.PAUSE_SECONDS)
+        return 0
+
+    # 子命令自己负责输出结果，db 层的操作提示会干扰脚本解析
+    # 数据库连接和结构检查都推迟到子命令第一次访问数据库时
+    db.QUIET = True
+    if args.profile:
+        with tracing.span(args.command, 'action'):
+            return args.func(args)
+    return args.func(args)
 
 
 if __name__ == '__main__':
-    main()
+    raise SystemExit(main())
@@ -0,0 +1,106 @@
+# todo/cache.py
+# 进程内缓存：TaskCache 由 db 模块的写操作就地更新，ResultCache 按代号整体失效
+
+import threading
+from collections import OrderedDict
+
+
+class TaskCache:
+    """
+    task_id -> Task 的内存副本。
+    字典按 (created_at, task_id) 升序保存，新添加的任务总是追加在末尾，
+    倒序遍历就是 get_all_todos 的显示顺序。
+    增量更新只能感知本进程内经过 db 模块的修改；别的进程的提交由 db 通过 PRAGMA data_version 发现后整体失效。
+    """
+
+    def __init__(self):
+        self._tasks = None
+
+    @property
+    def loaded(self):
+        return self._tasks is not None
+
+    def load(self, tasks):
+        """用按显示顺序（最新在前）排列的完整任务列表填充缓存"""
+        self._tasks = {task.task_id: task for task in reversed(tasks)}
+
+    def invalidate(self):
+        """丢弃缓存内容，下次读取时重新从数据库加载"""
+        self._tasks = None
+
+    def tasks(self):
+        """按显示顺序返回所有任务"""
+        return list(reversed(self._tasks.values()))
+
+    def put(self, task):
+        """添加或替换一个任务；已存在的任务保持原来的位置"""
+        if self._tasks is not None:
+            self._tasks[task.task_id] = task
+
+    def update(self, task_ids, **changes):
+        """把 changes 应用到 task_ids 中已缓存的任务上"""
+        if self._tasks is None:
+            return
+        for task_id in task_ids:
+            task = self._tasks.get(task_id)
+            if task is not None:
+                self._tasks[task_id] = task._replace(**changes)
+
+    def remove(self, task_ids):
+        if self._tasks is None:
+            return
+        for task_id in task_ids:
+            self._tasks.pop(task_id, None)
+
+
+class ResultCache:
+    """
+    查询结果的 LRU 缓存，键是 (函数名, 参数)。
+    每个条目记录写入时的代号（generation）；db 每次提交写事务、或发现别的进程改过数据库时代号加一，
+    代号不一致的条目视为过期。容量按缓存的总行数限制，超出时淘汰最久没用过的条目。
+    缓存的结果与调用方共享，调用方不能修改。
+    """
+
+    def __init__(self, max_rows, max_entries):
+        self.max_rows = max_rows
+        self.max_entries = max_entries
+        self._entries = OrderedDict()
+        self._rows = 0
+        self._lock = threading.Lock()
+        self.hits = 0
+        self.misses = 0
+
+    def get(self, key, generation):
+        """返回 (是否命中, 结果)"""
+        with self._lock:
+            entry = self._entries.get(key)
+            if entry is None or entry[0] != generation:
+                self.misses += 1
+                return False, None
+            self._entries.move_to_end(key)
+            self.hits += 1
+            return True, entry[1]
+
+    def put(self, key, generation, value):
+        size = len(value) if isinstance(value, list) else 1
+        if size > self.max_rows:
+            return
+        with self._lock:
+            old = self._entries.pop(key, None)
+            if old is not None:
+                self._rows -= old[2]
+            self._entries[key] = (generation, value, size)
+            self._rows += size
+            while self._rows > self.max_rows or len(self._entries) > self.max_entries:
+                _, (_, _, evicted) = self._entries.popitem(last=False)
+                self._rows -= evicted
+
+    def clear(self):
+        with self._lock:
+            self._entries.clear()
+            self._rows = 0
+
+    def stats(self):
+        with self._lock:
+            return {'entries': len(self._entries), 'rows': self._rows,
+                    'hits': self.hits, 'misses': self.misses}
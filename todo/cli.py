@@ -0,0 +1,420 @@
+# todo/cli.py
+# 非交互式的子命令，执行一次操作后立即退出
+#
+# 这些命令常被脚本和 shell 提示符高频调用，启动时间很重要：
+# json、render、transfer 等模块只在真正用到的子命令里才导入。
+
+import argparse
+import sqlite3
+import sys
+
+from . import db
+
+# list --status 的取值与 is_done 的对应关系
+STATUS_CHOICES = {'open': 0, 'done': 1, 'all': None}
+# 与 transfer.IMPORT_FORMATS / EXPORT_FORMATS 保持一致，避免为了构建参数解析器而导入 transfer
+IMPORT_FORMATS = ['csv', 'jsonl']
+EXPORT_FORMATS = ['csv', 'jsonl', 'parquet']
+
+
+def _backend():
+    """
+    正在运行 todo serve 时通过守护进程访问数据库，否则直接使用 db 模块。
+    两者提供同名同参数的函数，子命令不需要区分。
+    """
+    from . import client
+    return client.connect() or db
+
+def _daemon_errors(func):
+    """
+    用于通过 _backend() 访问数据库的子命令：守护进程出错、挂起超时时打印一行错误并返回 1，
+    不退回直接访问数据库，因为请求可能已经在守护进程里执行过了
+    """
+    def wrapper(args):
+        from . import client
+        try:
+            return func(args)
+        except client.DaemonError as e:
+            print(f"错误：{e}", file=sys.stderr)
+            return 1
+    wrapper.__name__ = func.__name__
+    wrapper.__doc__ = func.__doc__
+    return wrapper
+
+def _write_tasks(tasks, as_json):
+    """输出任务列表；--json 时每行一个 JSON 对象（JSON Lines），便于流式处理"""
+    if not as_json:
+        from .render import render_tasks
+        render_tasks(tasks)
+        return
+    import json
+    out = sys.stdout
+    for task in tasks:
+        out.write(json.dumps(task._asdict(), ensure_ascii=False))
+        out.write('\n')
+
+def _write_result(as_json, message, **result):
+    """输出单个操作的结果，--json 时输出一个 JSON 对象"""
+    if as_json:
+        import json
+        print(json.dumps(result, ensure_ascii=False))
+    else:
+        print(message)
+
+def _tag_arg(value):
+    """-t/--tag 参数的类型检查，标签名不合法时由 argparse 报错"""
+    try:
+        return db.normalize_tags([value])[0]
+    except ValueError as e:
+        raise argparse.ArgumentTypeError(str(e)) from None
+
+
+@_daemon_errors
+def cmd_add(args):
+    """todo add CONTENT... [--deadline D]"""
+    content = ' '.join(args.content)
+    try:
+        deadline = db.normalize_timestamp(args.deadline)
+    except ValueError as e:
+        print(f"错误：{e}", file=sys.stderr)
+        return 2
+    task = _backend().add_todo(content, deadline, tags=args.tag)
+    _write_result(args.json, f"已添加任务 {task.task_id}：{content}", task_id=task.task_id)
+    return 0
+
+@_daemon_errors
+def cmd_list(args):
+    """todo list [--status open|done|all] [--limit N] [--count]"""
+    status = STATUS_CHOICES[args.status]
+    if args.tag:
+        # 按标签过滤走 find_todos：先从标签找到任务，结果本身就不大
+        tasks = _backend().find_todos(status=status, tags=args.tag)
+        if args.count:
+            _write_result(args.json, str(len(tasks)), count=len(tasks))
+            return 0
+        _write_tasks(tasks[:args.limit] if args.limit is not None else tasks, args.json)
+        return 0
+    if args.count:
+        count = _backend().count_todos(status)
+        _write_result(args.json, str(count), count=count)
+        return 0
+    if args.limit is not None:
+        tasks = _backend().get_todos_page(args.limit, status=status)
+    else:
+        tasks = _backend().iter_todos(status=status)
+    _write_tasks(tasks, args.json)
+    return 0
+
+@_daemon_errors
+def cmd_summary(args):
+    """todo summary：一行概况，适合放进 shell 提示符"""
+    data = _backend().summary(soon_hours=args.soon_hours)
+    message = f"{data['open']} 未完成 / {data['done']} 已完成 / {data['overdue']} 已逾期 / {data['due_soon']} 即将到期"
+    _write_result(args.json, message, **data)
+    return 0
+
+@_daemon_errors
+def cmd_search(args):
+    """todo search TEXT [--status open|done|all]"""
+    tasks = _backend().find_todos(status=STATUS_CHOICES[args.status], text_search=args.text,
+                                  include_archive=args.archive, tags=args.tag)
+    if args.limit is not None:
+        tasks = tasks[:args.limit]
+    _write_tasks(tasks, args.json)
+    return 0
+
+@_daemon_errors
+def cmd_due(args):
+    """todo due [--days N]：接下来 N 天内到期的未完成任务，按截止日期排列"""
+    from datetime import datetime, timedelta
+    now = datetime.now()
+    due_before = (now + timedelta(days=args.days)).strftime(db.TIMESTAMP_FORMAT)
+    due_after = None if args.overdue else now.strftime(db.TIMESTAMP_FORMAT)
+    tasks = _backend().find_todos(status=0, due_after=due_after, due_before=due_before)
+    _write_tasks(tasks, args.json)
+    return 0
+
+@_daemon_errors
+def cmd_tag(args):
+    """todo tag ID... -t NAME [--remove]：给任务打上或去掉标签"""
+    if args.remove:
+        count = _backend().untag_todos(args.ids, args.tag)
+        _write_result(args.json, f"已去掉 {count} 个标签。", removed=count)
+    else:
+        count = _backend().tag_todos(args.ids, args.tag)
+        _write_result(args.json, f"已添加 {count} 个标签。", added=count)
+    return 0
+
+@_daemon_errors
+def cmd_tags(args):
+    """todo tags [--import-hashtags]：列出所有标签及其任务数量"""
+    if args.import_hashtags:
+        count = db.import_hashtags()
+        if not args.json:
+            print(f"已从任务内容中识别出 {count} 个标签。")
+    counts = _backend().tag_counts()
+    if args.json:
+        import json
+        for item in counts:
+            print(json.dumps(item, ensure_ascii=False))
+        return 0
+    for item in counts:
+        print(f"#{item['name']}  {item['open']} 未完成 / {item['tasks']} 个任务")
+    return 0
+
+@_daemon_errors
+def cmd_done(args):
+    """todo done ID... [--undo]"""
+    is_done = 0 if args.undo else 1
+    count = _backend().set_status_many(args.ids, is_done)
+    _write_result(args.json, f"已更新 {count} 个任务的状态。", updated=count, is_done=is_done)
+    return 0 if count == len(set(args.ids)) else 1
+
+@_daemon_errors
+def cmd_rm(args):
+    """todo rm ID..."""
+    count = _backend().delete_many(args.ids)
+    _write_result(args.json, f"已删除 {count} 个任务。", deleted=count)
+    return 0 if count == len(set(args.ids)) else 1
+
+def cmd_archive(args):
+    """todo archive [--days N]：把完成已久的任务移到归档表"""
+    count = db.archive_done(args.days, vacuum=not args.no_vacuum)
+    _write_result(args.json, f"已归档 {count} 个任务。", archived=count)
+    return 0
+
+def cmd_backup(args):
+    """todo backup DEST：在线备份数据库，备份期间其他进程照常读写"""
+    try:
+        size = db.backup(args.dest, pages=args.pages)
+    except (OSError, sqlite3.Error) as e:
+        print(f"备份失败：{e}", file=sys.stderr)
+        return 1
+    _write_result(args.json, f"已备份到 {args.dest}（{size} 字节）。", path=args.dest, bytes=size)
+    return 0
+
+def cmd_compact(args):
+    """todo compact [--full] [--into FILE]：回收空闲页并更新统计信息，报告回收的空间"""
+    try:
+        result = db.compact(into=args.into, full=args.full, analyze=not args.no_analyze)
+    except (OSError, ValueError, sqlite3.Error) as e:
+        print(f"整理失败：{e}", file=sys.stderr)
+        return 1
+    _write_result(args.json, f"整理完成：{result['before']} → {result['after']} 字节，"
+                             f"回收 {result['reclaimed']} 字节。", **result)
+    return 0
+
+def cmd_import(args):
+    """todo import FILE：把 CSV / JSONL 文件中的任务批量导入数据库"""
+    from . import transfer
+    fmt = args.format or transfer.guess_format(args.file)
+    if fmt is None:
+        print("错误：无法从文件名推断格式，请使用 --format 指定。", file=sys.stderr)
+        return 2
+    try:
+        count = db.add_todos(transfer.iter_import(args.file, fmt), chunk_size=args.chunk_size)
+    except (OSError, ValueError) as e:
+        print(f"导入失败：{e}", file=sys.stderr)
+        return 1
+    _write_result(args.json, f"已导入 {count} 个任务。", imported=count)
+    return 0
+
+def cmd_export(args):
+    """todo export FILE：把全部任务流式导出为 CSV / JSONL / Parquet"""
+    from . import transfer
+    fmt = args.format or transfer.guess_format(args.file, transfer.EXPORT_FORMATS)
+    if fmt is None:
+        print("错误：无法从文件名推断格式，请使用 --format 指定。", file=sys.stderr)
+        return 2
+    try:
+        count = transfer.export(args.file, fmt, db.EXPORT_COLUMNS,
+                                db.iter_export_batches(args.batch_size))
+    except BrokenPipeError:
+        # 导出到标准输出时下游提前关闭，交给 __main__.main 统一处理
+        raise
+    except (OSError, ValueError) as e:
+        print(f"导出失败：{e}", file=sys.stderr)
+        return 1
+    if args.file != '-':
+        _write_result(args.json, f"已导出 {count} 个任务。", exported=count)
+    return 0
+
+def cmd_sync(args):
+    """todo sync --since SEQ | --apply FILE | --prune SEQ：在机器之间增量同步，见 sync.py"""
+    from . import sync
+    try:
+        if args.apply:
+            upserted, archived, deleted, until = sync.apply_file(args.apply)
+            _write_result(args.json, f"已应用到序号 {until}：写入 {upserted} 个任务，"
+                                     f"归档 {archived} 个任务，删除 {deleted} 个任务。",
+                          upserted=upserted, archived=archived, deleted=deleted, until=until)
+        elif args.prune is not None:
+            count = db.prune_changes(args.prune)
+            _write_result(args.json, f"已清理 {count} 条变更记录。", pruned=count)
+        else:
+            count, until = sync.export_changes(args.output, args.since)
+            message = f"已导出 {count} 个变更，下次同步使用 --since {until}。"
+            if args.output == '-':
+                # 标准输出被同步文件占用，提示写到标准错误
+                print(message, file=sys.stderr)
+            else:
+                _write_result(args.json, message, exported=count, until=until)
+    except BrokenPipeError:
+        raise
+    except (OSError, ValueError) as e:
+        print(f"同步失败：{e}", file=sys.stderr)
+        return 1
+    return 0
+
+def cmd_remind(args):
+    """todo remind：常驻运行，到截止时间时打印提醒"""
+    from .scheduler import Scheduler
+    lead_time = None if args.lead is None else args.lead * 60
+    scheduler = Scheduler(lead_time=lead_time)
+    try:
+        scheduler.run()
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+def cmd_stats(args):
+    """todo stats：查看守护进程收集的语句统计"""
+    from . import client
+    from . import instrument
+    remote = client.connect()
+    if remote is None:
+        print("没有正在运行的 todo serve。单次命令的统计可以用 TODO_STATS=1 todo ... 查看。", file=sys.stderr)
+        return 1
+    data = remote.call('stats')
+    if args.reset:
+        remote.call('reset_stats')
+    if args.json:
+        import json
+        print(json.dumps(data, ensure_ascii=False))
+    else:
+        sys.stdout.write(instrument.format_summary(data))
+    return 0
+
+def cmd_serve(args):
+    """todo serve：常驻运行，让其他 todo 命令复用预热好的连接"""
+    from . import server
+    try:
+        if not server.serve(args.socket):
+            print("守护进程已经在运行。", file=sys.stderr)
+            return 1
+    except KeyboardInterrupt:
+        pass
+    return 0
+
+
+def build_parser():
+    """构建命令行解析器；不带子命令时进入交互式菜单"""
+    parser = argparse.ArgumentParser(prog='todo', description='一个简单的命令行待办事项应用。')
+    parser.add_argument('--profile', metavar='FILE',
+                        help='剖析耗时并在退出时写到 FILE：.json 为 Chrome trace 事件，其他扩展名为 cProfile 统计')
+    parser.add_argument('--no-pause', action='store_true', help='交互模式下每次操作后不暂停，便于脚本驱动')
+    subparsers = parser.add_subparsers(dest='command', metavar='COMMAND')
+
+    # 所有子命令共用的选项
+    common = argparse.ArgumentParser(add_help=False)
+    common.add_argument('--json', action='store_true', help='输出 JSON，便于脚本处理')
+
+    p = subparsers.add_parser('add', parents=[common], help='添加一个任务')
+    p.add_argument('content', nargs='+', help='任务内容')
+    p.add_argument('--deadline', help='截止日期，格式 YYYY-MM-DD HH:MM:SS，也可以只写日期')
+    p.add_argument('-t', '--tag', type=_tag_arg, action='append', default=[], help='标签，可以重复使用')
+    p.set_defaults(func=cmd_add)
+
+    p = subparsers.add_parser('list', parents=[common], help='列出任务')
+    p.add_argument('--status', choices=STATUS_CHOICES, default='all', help='按完成状态过滤')
+    p.add_argument('--limit', type=int, help='最多显示多少个任务')
+    p.add_argument('--count', action='store_true', help='只输出任务数量')
+    p.add_argument('-t', '--tag', type=_tag_arg, action='append', default=[], help='只列出带有这个标签的任务，可以重复使用')
+    p.set_defaults(func=cmd_list)
+
+    p = subparsers.add_parser('summary', parents=[common], help='输出任务数量、逾期与即将到期的概况')
+    p.add_argument('--soon-hours', type=int, default=db.DUE_SOON_HOURS, help='多少小时内到期算作即将到期')
+    p.set_defaults(func=cmd_summary)
+
+    p = subparsers.add_parser('search', parents=[common], help='按内容搜索任务')
+    p.add_argument('text', help='要搜索的关键词')
+    p.add_argument('--status', choices=STATUS_CHOICES, default='all', help='按完成状态过滤')
+    p.add_argument('--limit', type=int, help='最多显示多少个任务')
+    p.add_argument('--archive', action='store_true', help='同时搜索已归档的任务')
+    p.add_argument('-t', '--tag', type=_tag_arg, action='append', default=[], help='只搜索带有这个标签的任务，可以重复使用')
+    p.set_defaults(func=cmd_search)
+
+    p = subparsers.add_parser('due', parents=[common], help='列出接下来几天内到期的未完成任务')
+    p.add_argument('--days', type=int, default=7, help='向后看多少天，默认 7')
+    p.add_argument('--overdue', action='store_true', help='同时列出已经逾期的任务')
+    p.set_defaults(func=cmd_due)
+
+    p = subparsers.add_parser('tag', parents=[common], help='给任务打上或去掉标签')
+    p.add_argument('ids', nargs='+', type=int, metavar='ID', help='任务 ID')
+    p.add_argument('-t', '--tag', type=_tag_arg, action='append', required=True, help='标签，可以重复使用')
+    p.add_argument('--remove', action='store_true', help='改为去掉这些标签')
+    p.set_defaults(func=cmd_tag)
+
+    p = subparsers.add_parser('tags', parents=[common], help='列出所有标签及其任务数量')
+    p.add_argument('--import-hashtags', action='store_true', help='先把任务内容中的 #标签 转成标签（一次性）')
+    p.set_defaults(func=cmd_tags)
+
+    p = subparsers.add_parser('done', parents=[common], help='把任务标记为完成')
+    p.add_argument('ids', nargs='+', type=int, metavar='ID', help='任务 ID')
+    p.add_argument('--undo', action='store_true', help='改为标记为未完成')
+    p.set_defaults(func=cmd_done)
+
+    p = subparsers.add_parser('rm', parents=[common], help='删除任务')
+    p.add_argument('ids', nargs='+', type=int, metavar='ID', help='任务 ID')
+    p.set_defaults(func=cmd_rm)
+
+    p = subparsers.add_parser('archive', parents=[common], help='把完成已久的任务移到归档表')
+    p.add_argument('--days', type=int, help='完成超过多少天才归档，默认读取 [archive] after_days')
+    p.add_argument('--no-vacuum', action='store_true', help='归档后不回收磁盘空间')
+    p.set_defaults(func=cmd_archive)
+
+    p = subparsers.add_parser('backup', parents=[common], help='在线备份数据库到文件')
+    p.add_argument('dest', help='备份文件；已存在时会被替换')
+    p.add_argument('--pages', type=int, help='每一步复制的页数，默认读取 [backup] pages，-1 表示一步完成')
+    p.set_defaults(func=cmd_backup)
+
+    p = subparsers.add_parser('compact', parents=[common], help='回收数据库空闲空间并更新查询统计信息')
+    group = p.add_mutually_exclusive_group()
+    group.add_argument('--full', action='store_true', help='完整 VACUUM 重建数据库，也回收半空的页；期间数据库被锁住')
+    group.add_argument('--into', metavar='FILE', help='不改动当前数据库，把重建后的副本写到 FILE')
+    p.add_argument('--no-analyze', action='store_true', help='不运行 ANALYZE')
+    p.set_defaults(func=cmd_compact)
+
+    p = subparsers.add_parser('import', parents=[common], help='从 CSV 或 JSONL 文件批量导入任务')
+    p.add_argument('file', help="要导入的文件，'-' 表示标准输入")
+    p.add_argument('--format', choices=IMPORT_FORMATS, help='文件格式，默认根据扩展名推断')
+    p.add_argument('--chunk-size', type=int, default=db.CHUNK_SIZE, help='每批写入的行数')
+    p.set_defaults(func=cmd_import)
+
+    p = subparsers.add_parser('export', parents=[common], help='把全部任务导出为 CSV、JSONL 或 Parquet 文件')
+    p.add_argument('file', help="导出到的文件，'-' 表示标准输出")
+    p.add_argument('--format', choices=EXPORT_FORMATS, help='文件格式，默认根据扩展名推断')
+    p.add_argument('--batch-size', type=int, default=db.EXPORT_BATCH_SIZE, help='每批读取的行数')
+    p.set_defaults(func=cmd_export)
+
+    p = subparsers.add_parser('sync', parents=[common], help='导出或应用增量变更，在机器之间同步任务')
+    mode = p.add_mutually_exclusive_group()
+    mode.add_argument('--since', type=int, default=0, metavar='SEQ', help='导出这个序号之后的变更，默认 0 即全部')
+    mode.add_argument('--apply', metavar='FILE', help="应用另一台机器导出的文件，'-' 表示标准输入")
+    mode.add_argument('--prune', type=int, metavar='SEQ', help='删除不大于这个序号的变更记录，之后只能从这个序号起增量导出')
+    p.add_argument('-o', '--output', default='-', help="导出到的文件，默认标准输出")
+    p.set_defaults(func=cmd_sync)
+
+    p = subparsers.add_parser('remind', help='常驻运行，在任务到达截止时间时提醒')
+    p.add_argument('--lead', type=int, metavar='MINUTES', help='提前多少分钟提醒，默认读取 [scheduler] lead_time（秒）')
+    p.set_defaults(func=cmd_remind)
+
+    p = subparsers.add_parser('stats', parents=[common], help='查看守护进程的 SQL 语句统计')
+    p.add_argument('--reset', action='store_true', help='查看后清空统计')
+    p.set_defaults(func=cmd_stats)
+
+    p = subparsers.add_parser('serve', help='以守护进程方式运行，加速其他 todo 命令')
+    p.add_argument('--socket', help='Unix 套接字路径，默认读取 [server] socket')
+    p.set_defaults(func=cmd_serve)
+
+    return parser
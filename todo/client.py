@@ -0,0 +1,154 @@
+# todo/client.py
+# todo serve 守护进程的客户端。协议是 Unix 套接字上的 JSON Lines：
+#
+#   请求  {"op": "count_todos", "args": {"status": 0}}
+#   响应  {"ok": true, "value": 3}
+#         {"ok": true, "task": [task_id, content, is_done, created_at, deadline]}
+#         {"ok": true, "tasks": [[...], [...]]}
+#         {"ok": false, "error": "..."}
+#
+# 任务按 Task 的字段顺序编码成数组，不重复传字段名。
+#
+# 每个命令行子命令都会先调用 connect()，守护进程没有运行时它只做一次 os.path.exists，
+# 所以 json、socket 都推迟到确实要通信时才导入。
+
+import os
+import zlib
+
+from . import config
+from . import db
+
+# 客户端等待守护进程响应的超时时间（秒）
+TIMEOUT = 10
+
+
+class DaemonError(Exception):
+    """守护进程返回了错误"""
+
+
+def default_socket_path():
+    """
+    守护进程的套接字路径，可用 [server] socket 配置。
+    默认路径包含当前用户和数据库文件的绝对路径摘要，不同目录下的数据库不会互相串用。
+    """
+    configured = config.get('server', 'socket')
+    if configured:
+        return configured
+    runtime_dir = os.environ.get('XDG_RUNTIME_DIR') or '/tmp'
+    digest = zlib.crc32(os.path.abspath(db.database_path()).encode('utf-8'))
+    return os.path.join(runtime_dir, f"todo-{os.getuid()}-{digest:08x}.sock")
+
+def encode(value):
+    """把 db 函数的返回值编码成响应"""
+    if isinstance(value, db.Task):
+        return {'ok': True, 'task': list(value)}
+    if isinstance(value, list) and value and isinstance(value[0], db.Task):
+        return {'ok': True, 'tasks': [list(task) for task in value]}
+    return {'ok': True, 'value': value}
+
+def decode(response):
+    """把响应还原成 db 函数的返回值"""
+    if not response.get('ok'):
+        raise DaemonError(response.get('error', '未知错误'))
+    if 'task' in response:
+        return db.Task._make(response['task'])
+    if 'tasks' in response:
+        return [db.Task._make(task) for task in response['tasks']]
+    return response.get('value')
+
+
+class Client:
+    """
+    与守护进程之间的一条连接。提供和 db 模块同名、同参数的读写函数，
+    命令行子命令因此可以不加区分地使用本地 db 或守护进程。
+    """
+
+    def __init__(self, sock):
+        self._sock = sock
+        self._reader = sock.makefile('r', encoding='utf-8')
+
+    def call(self, op, **args):
+        """发送一个请求并等待响应；超时、连接断开和响应无法解析都抛出 DaemonError"""
+        import json
+        import socket
+        request = json.dumps({'op': op, 'args': args}, ensure_ascii=False) + '\n'
+        try:
+            self._sock.sendall(request.encode('utf-8'))
+            line = self._reader.readline()
+        except socket.timeout:
+            raise DaemonError(f"守护进程 {TIMEOUT} 秒内没有响应") from None
+        except OSError as e:
+            raise DaemonError(f"与守护进程通信失败：{e}") from None
+        if not line:
+            raise DaemonError("守护进程关闭了连接")
+        try:
+            response = json.loads(line)
+        except ValueError:
+            raise DaemonError("守护进程返回了无法解析的响应") from None
+        return decode(response)
+
+    def close(self):
+        self._reader.close()
+        self._sock.close()
+
+    def add_todo(self, content, deadline=None, tags=()):
+        return self.call('add_todo', content=content, deadline=deadline, tags=list(tags))
+
+    def count_todos(self, status=None):
+        return self.call('count_todos', status=status)
+
+    def summary(self, now=None, soon_hours=db.DUE_SOON_HOURS):
+        return self.call('summary', now=now, soon_hours=soon_hours)
+
+    def get_todos_page(self, limit, after=None, status=None):
+        return self.call('get_todos_page', limit=limit, after=after, status=status) or []
+
+    def iter_todos(self, status=None, page_size=db.PAGE_SIZE):
+        """与 db.iter_todos 一样按页读取，每页一次请求"""
+        after = None
+        while True:
+            page = self.get_todos_page(page_size, after, status)
+            yield from page
+            if len(page) < page_size:
+                return
+            last = page[-1]
+            after = [last.created_at, last.task_id]
+
+    def find_todos(self, status=None, text_search=None, include_archive=False,
+                   due_before=None, due_after=None, started=None, now=None, tags=()):
+        return self.call('find_todos', status=status, text_search=text_search,
+                         include_archive=include_archive, due_before=due_before,
+                         due_after=due_after, started=started, now=now, tags=list(tags)) or []
+
+    def tag_todos(self, task_ids, names):
+        return self.call('tag_todos', task_ids=list(task_ids), names=list(names))
+
+    def untag_todos(self, task_ids, names):
+        return self.call('untag_todos', task_ids=list(task_ids), names=list(names))
+
+    def tag_counts(self):
+        return self.call('tag_counts')
+
+    def set_status_many(self, task_ids, is_done):
+        return self.call('set_status_many', task_ids=list(task_ids), is_done=is_done)
+
+    def delete_many(self, task_ids):
+        return self.call('delete_many', task_ids=list(task_ids))
+
+
+def connect(path=None):
+    """连接正在运行的守护进程；没有运行时返回 None"""
+    path = path or default_socket_path()
+    if not os.path.exists(path):
+        return None
+    import socket
+    if not hasattr(socket, 'AF_UNIX'):
+        return None
+    sock = socket.socket(socket.AF_UNIX, socket.SOCK_STREAM)
+    sock.settimeout(TIMEOUT)
+    try:
+        sock.connect(path)
+    except OSError:
+        sock.close()
+        return None
+    return Client(sock)
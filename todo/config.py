@@ -0,0 +1,49 @@
+# todo/config.py
+# 读取配置。优先级：环境变量 > 配置文件 > 代码中的默认值
+#
+# 配置文件是 INI 格式，默认位于 ~/.config/todo/config.ini，可以用 TODO_CONFIG 指定其他路径：
+#
+#   [database]
+#   profile = balanced
+#   cache_size = -16000
+#
+# 同一项也可以用环境变量覆盖，名字是 TODO_<SECTION>_<KEY>，例如 TODO_DATABASE_PROFILE=safe
+
+import os
+
+CONFIG_PATH = os.environ.get('TODO_CONFIG', os.path.expanduser('~/.config/todo/config.ini'))
+
+_file_config = None
+
+
+def _load_file():
+    """
+    第一次用到时才读取配置文件，返回 {section: {key: value}}。
+    文件不存在时直接得到空配置，连 configparser 都不用导入。
+    """
+    global _file_config
+    if _file_config is None:
+        _file_config = {}
+        if os.path.exists(CONFIG_PATH):
+            import configparser
+            parser = configparser.ConfigParser()
+            parser.read(CONFIG_PATH, encoding='utf-8')
+            _file_config = {name: dict(parser[name]) for name in parser.sections()}
+    return _file_config
+
+def get(section, key, default=None):
+    """读取一项配置，返回字符串；都没有设置时返回 default"""
+    value = os.environ.get(f"TODO_{section}_{key}".upper())
+    if value is not None:
+        return value
+    return _load_file().get(section, {}).get(key, default)
+
+def get_int(section, key, default):
+    """读取一项整数配置"""
+    value = get(section, key)
+    if value is None:
+        return default
+    try:
+        return int(value)
+    except ValueError:
+        raise ValueError(f"配置项 [{section}] {key} 必须是整数，当前为 {value!r}") from None
@@ -1,130 +1,1342 @@
+import atexit
+import contextlib
+import functools
+import os
+import re
 import sqlite3 # Python 内置的数据库模块，非常适合这个项目
+import threading
+import time
+from collections import namedtuple
 
-# 定义数据库文件的路径
-# 它会在项目根目录的 data 文件夹下创建一个名为 todo.db 的文件
-DATABASE_PATH = 'data/todo.db'
-SCHEMA_PATH = 'todo/schema.sql'
+from . import config
+from . import instrument
+from . import query
 
-def get_db():
+# 数据库的位置。DATABASE_PATH 为 None 时读取 [database] path（环境变量 TODO_DATABASE_PATH），
+# 都没有设置时使用 DEFAULT_DATABASE_PATH，即当前目录下的 data/todo.db；所在目录不存在时会自动创建。
+#   :memory:                       本进程内的内存数据库（memdb VFS），所有线程共用；[database] snapshot 指定文件时，
+#                                  启动时从该文件载入，退出时用 backup API 写回。内存库没有 WAL，
+#                                  写事务进行中读者要等它提交（最多 busy_timeout），而不是像文件库那样读旧版本
+#   file:...?vfs=memdb 等 URI      原样交给 SQLite（uri=True）
+DATABASE_PATH = None
+DEFAULT_DATABASE_PATH = 'data/todo.db'
+MEMORY_PATH = ':memory:'
+# 需要的最低 SQLite 版本（Python 自带的 sqlite3 链接的库，见 sqlite3.sqlite_version）：
+# RETURNING 与 DROP COLUMN 要 3.35，upsert、trigram 分词、VACUUM INTO 更早就有；内存模式的 memdb VFS 要 3.36
+MIN_SQLITE_VERSION = (3, 35, 0)
+MIN_SQLITE_VERSION_MEMORY = (3, 36, 0)
+# 迁移脚本随包一起安装在 todo/migrations 下，文件名形如 0001_create_todo.sql，前缀数字就是版本号
+MIGRATIONS_PACKAGE = 'todo'
+MIGRATIONS_DIR = 'migrations'
+# 最新迁移脚本的版本号，新增迁移时要同步修改
+# 数据库的 user_version 等于它时，启动时不需要读取任何迁移文件
+SCHEMA_VERSION = 11
+_MIGRATION_NAME = re.compile(r'^(\d+)_\w+\.sql$')
+
+# trigram 分词的全文索引只能匹配至少 3 个字符的关键词
+FTS_MIN_CHARS = 3
+
+# 合法的标签名：不含空白和 #，写在 content 里的 #标签 也按这个规则识别
+_TAG_NAME = re.compile(r'[^\s#]+')
+_HASHTAG = re.compile(r'(?<![^\s(（])#([^\s#,.;:!?，。；：！？)）]+)')
+
+# 时间字段（created_at、deadline 等）的文本格式
+TIMESTAMP_FORMAT = '%Y-%m-%d %H:%M:%S'
+# fromisoformat 不接受的其他输入写法（比如月、日没有补零），按顺序尝试
+TIMESTAMP_INPUT_FORMATS = ('%Y-%m-%d %H:%M:%S', '%Y-%m-%d %H:%M', '%Y-%m-%d')
+# summary() 中多少小时内到期算作“即将到期”
+DUE_SOON_HOURS = 24
+
+# iter_todos 每次从数据库读取的行数
+PAGE_SIZE = 500
+
+# 批量操作时每次 executemany 提交给 SQLite 的行数
+CHUNK_SIZE = 1000
+
+# 完成超过这么多天的任务会被 archive_done 移到 todo_archive，可用 [archive] after_days 覆盖
+ARCHIVE_AFTER_DAYS = 30
+# 导出时每次 fetchmany 取回的行数
+EXPORT_BATCH_SIZE = 5000
+# 导出的列，顺序即导出文件中的列顺序
+EXPORT_COLUMNS = ('task_id', 'content', 'is_done', 'created_at', 'start_at', 'deadline', 'done_at')
+# 归档时每个事务移动的任务数量，避免长时间持有写锁
+ARCHIVE_BATCH_SIZE = 1000
+# iter_changes / apply_changes 中变更的种类：任务新增或修改、被移到归档表、被删除
+CHANGE_UPSERT = 'upsert'
+CHANGE_ARCHIVE = 'archive'
+CHANGE_DELETE = 'delete'
+# 在线备份每一步复制的页数，步与步之间休息 BACKUP_SLEEP 秒，其他连接可以在这期间读写；
+# 页数可用 [backup] pages 覆盖，-1 表示一步复制完
+BACKUP_PAGES = 1000
+BACKUP_SLEEP = 0.005
+
+# 为 True 时不打印操作提示，供输出需要保持干净的命令行子命令（如 --json）使用
+QUIET = False
+
+# 每个连接缓存的预编译语句数量，重复执行的 SQL 不必每次重新解析
+STATEMENT_CACHE_SIZE = 128
+# 线程归还后保留的空闲连接数量上限
+POOL_SIZE = 4
+
+# 并发写入：写事务用 BEGIN IMMEDIATE 一开始就拿写锁，拿不到时由 SQLite 等待最多 busy_timeout 毫秒；
+# 仍然拿不到就随机退避后重试。三项都可以在 [database] 中覆盖（busy_timeout_ms、busy_retries、busy_backoff_ms）
+BUSY_TIMEOUT_MS = 5000
+BUSY_RETRIES = 3
+# 第 n 次重试前在 [0, busy_backoff_ms * 2**n) 毫秒之间随机等待，避免多个进程同时醒来再次冲突
+BUSY_BACKOFF_MS = 50
+
+# 持久性配置档，通过配置项 [database] profile 选择
+DURABILITY_PROFILES = {
+    # 每次提交都 fsync，断电也不会丢失已提交的事务
+    'safe': {'journal_mode': 'WAL', 'synchronous': 'FULL'},
+    # WAL 下 NORMAL 只在检查点时 fsync：崩溃不会损坏数据库，但断电可能丢失最近几次提交
+    'balanced': {'journal_mode': 'WAL', 'synchronous': 'NORMAL'},
+    # 完全不 fsync，只适合随时可以重建的数据
+    'fast': {'journal_mode': 'WAL', 'synchronous': 'OFF'},
+}
+DEFAULT_PROFILE = 'balanced'
+
+# 与配置档无关的连接参数，每一项都可以在 [database] 中单独覆盖
+PRAGMA_DEFAULTS = {
+    'cache_size': '-16000',       # 负数表示 KiB，即约 16 MB 页缓存
+    'mmap_size': '268435456',     # 256 MB 内存映射读取
+    'temp_store': 'MEMORY',       # 临时表和排序放在内存里
+    'wal_autocheckpoint': '1000', # WAL 超过 1000 页时自动检查点
+}
+_PRAGMA_VALUE = re.compile(r'^-?\w+$')
+
+# 写操作之间至少间隔这么多秒才主动做一次 PASSIVE 检查点，可用 [database] checkpoint_interval 覆盖
+CHECKPOINT_INTERVAL = 60
+_last_checkpoint = time.monotonic()
+
+# 每个线程持有一个长期连接，类似 Flask 的 g 对象
+_local = threading.local()
+_idle_conns = []
+_pool_lock = threading.Lock()
+
+# 查询结果缓存的容量：缓存的总行数与条目数上限，可用 [cache] max_rows / max_entries 覆盖，max_rows 为 0 时关闭
+RESULT_CACHE_ROWS = 100000
+RESULT_CACHE_ENTRIES = 256
+
+# 任务列表的内存缓存，调用 enable_task_cache() 后才启用
+_task_cache = None
+# 查询结果缓存（cache.ResultCache），第一次查询时按配置创建，关闭时为 False
+_result_cache = None
+# 写事务每次结束加一，结果缓存中代号不一致的条目即为过期
+_generation = 0
+# 每个连接上次看到的 PRAGMA data_version（按 id(conn)），变化说明别的连接或进程提交过
+_data_versions = {}
+_generation_lock = threading.Lock()
+# 关注任务变化的观察者（缓存、提醒调度器等），每个都要实现 put / update / remove / invalidate
+_observers = []
+
+# 内存模式下一直打开的连接：共享缓存的内存数据库在最后一个连接关闭时就消失了
+_memory_anchor = None
+_memory_lock = threading.Lock()
+
+# 本进程已经确认过结构是最新的数据库位置（database_path()），还没有确认过时为 None。
+# 切换 DATABASE_PATH 或 close_db() 之后（内存数据库随之消失）会重新检查
+_schema_ready = None
+_schema_lock = threading.Lock()
+
+
+def _report(message):
+    """打印一条操作提示，QUIET 模式下什么也不做"""
+    if not QUIET:
+        print(message)
+
+def database_path():
+    """当前使用的数据库位置，见 DATABASE_PATH 的说明"""
+    return DATABASE_PATH or config.get('database', 'path', DEFAULT_DATABASE_PATH)
+
+def _connect_target():
+    """返回 (sqlite3.connect 的 database 参数, 是否按 URI 解析)"""
+    path = database_path()
+    if path == MEMORY_PATH:
+        _open_memory_anchor()
+        return _memory_uri(), True
+    if path.startswith('file:'):
+        return path, True
+    directory = os.path.dirname(path)
+    if directory:
+        os.makedirs(directory, exist_ok=True)
+    return path, False
+
+def _memory_uri():
     """
-    打开一个数据库连接。
-    后续我们会优化这里，实现类似 Flask g 对象的功能。
-    但现在，先让它返回一个新连接。
+    内存模式的数据库。普通的 :memory: 每个连接各是一个数据库；memdb VFS 中以 / 开头的名字
+    在本进程内共享，线程池里的连接看到的是同一份数据。不用 mode=memory&cache=shared：
+    共享缓存用表级锁，写事务进行中读者会直接得到 SQLITE_LOCKED，busy_timeout 不起作用
     """
-    conn = sqlite3.connect(DATABASE_PATH)
+    return f"file:/todo-{os.getpid()}?vfs=memdb"
+
+def _open_memory_anchor():
+    """内存模式下第一次连接前调用：打开常驻连接，并从快照文件载入数据"""
+    global _memory_anchor
+    with _memory_lock:
+        if _memory_anchor is not None:
+            return
+        anchor = sqlite3.connect(_memory_uri(), uri=True, check_same_thread=False)
+        snapshot = config.get('database', 'snapshot')
+        if snapshot and os.path.exists(snapshot):
+            source = sqlite3.connect(snapshot)
+            try:
+                source.backup(anchor)
+            finally:
+                source.close()
+        _memory_anchor = anchor
+
+def _save_memory_snapshot():
+    """进程退出时把内存数据库写到 [database] snapshot"""
+    snapshot = config.get('database', 'snapshot')
+    if not snapshot:
+        return
+    _backup_to(_memory_anchor, snapshot)
+
+def _backup_to(source, path, pages=-1, progress=None, sleep=0.25):
+    """
+    用 backup API 把 source 复制到文件 path。先写 path.tmp 再改名，中途失败不会留下半个文件，
+    已有的 path 也保持原样。pages、progress、sleep 的含义同 sqlite3.Connection.backup。
+    """
+    directory = os.path.dirname(path)
+    if directory:
+        os.makedirs(directory, exist_ok=True)
+    temp = path + '.tmp'
+    dest = sqlite3.connect(temp)
+    try:
+        source.backup(dest, pages=pages, progress=progress, sleep=sleep)
+    except BaseException:
+        dest.close()
+        os.remove(temp)
+        raise
+    dest.close()
+    os.replace(temp, path)
+
+class SQLiteVersionError(RuntimeError):
+    """Python 链接的 SQLite 版本太旧"""
+
+
+def _check_sqlite_version(memory):
+    required = MIN_SQLITE_VERSION_MEMORY if memory else MIN_SQLITE_VERSION
+    if sqlite3.sqlite_version_info < required:
+        mode = "内存模式" if memory else "todo "
+        raise SQLiteVersionError(
+            f"{mode}需要 SQLite {'.'.join(map(str, required))} 或更新的版本，"
+            f"当前 Python 使用的是 {sqlite3.sqlite_version}，请升级 Python 或系统的 SQLite 库")
+
+def _connect():
+    """真正打开一个新的数据库连接"""
+    _check_sqlite_version(database_path() == MEMORY_PATH)
+    # check_same_thread=False：连接会在池中被不同线程复用，但同一时刻只属于一个线程
+    options = {}
+    factory = instrument.connection_factory()
+    if factory is not None:
+        # 开启统计时用带计时的连接类，见 instrument.py
+        options['factory'] = factory
+    target, uri = _connect_target()
+    conn = sqlite3.connect(
+        target,
+        uri=uri,
+        timeout=config.get_int('database', 'busy_timeout_ms', BUSY_TIMEOUT_MS) / 1000,
+        check_same_thread=False,
+        cached_statements=STATEMENT_CACHE_SIZE,
+        **options,
+    )
+    instrument.record_connect()
     # 这行让查询结果可以像字典一样通过列名访问，更方便
     conn.row_factory = sqlite3.Row
+    _apply_pragmas(conn)
+    _ensure_schema(conn)
+    return conn
+
+def _connection_pragmas():
+    """合并配置档、默认参数和用户配置，得到每个新连接要执行的 PRAGMA"""
+    profile = config.get('database', 'profile', DEFAULT_PROFILE)
+    if profile not in DURABILITY_PROFILES:
+        raise ValueError(f"未知的持久性配置档 {profile!r}，可选：{', '.join(DURABILITY_PROFILES)}")
+
+    pragmas = dict(PRAGMA_DEFAULTS)
+    pragmas.update(DURABILITY_PROFILES[profile])
+    for name in pragmas:
+        value = config.get('database', name, pragmas[name])
+        # PRAGMA 的值不能用 ? 占位，只接受简单的标识符或整数
+        if not _PRAGMA_VALUE.match(value):
+            raise ValueError(f"配置项 [database] {name} 的值不合法：{value!r}")
+        pragmas[name] = value
+    return pragmas
+
+def _apply_pragmas(conn):
+    """新连接打开后执行一次，设置日志模式、同步级别和缓存"""
+    for name, value in _connection_pragmas().items():
+        conn.execute(f"PRAGMA {name} = {value};")
+
+def checkpoint(mode='PASSIVE'):
+    """
+    把 WAL 文件中的内容写回主数据库。
+    mode: PASSIVE 不等待读者；FULL / RESTART / TRUNCATE 会等待并尽量清空 WAL
+    返回 (是否被阻塞, WAL 总页数, 已写回页数)
+    """
+    global _last_checkpoint
+    if mode not in ('PASSIVE', 'FULL', 'RESTART', 'TRUNCATE'):
+        raise ValueError(f"未知的检查点模式 {mode!r}")
+    result = get_db().execute(f"PRAGMA wal_checkpoint({mode});").fetchone()
+    _last_checkpoint = time.monotonic()
+    return tuple(result)
+
+def _maybe_checkpoint():
+    """写操作之后调用：距离上次检查点足够久时做一次不阻塞的 PASSIVE 检查点"""
+    interval = config.get_int('database', 'checkpoint_interval', CHECKPOINT_INTERVAL)
+    if time.monotonic() - _last_checkpoint >= interval:
+        checkpoint('PASSIVE')
+
+def _is_busy(error):
+    """数据库被其他连接锁住：SQLITE_BUSY，或共享缓存（URI 指定 cache=shared 时）下的 SQLITE_LOCKED，及其扩展错误码"""
+    code = getattr(error, 'sqlite_errorcode', None)
+    if code is not None:
+        return code & 0xff in (sqlite3.SQLITE_BUSY, sqlite3.SQLITE_LOCKED)
+    return 'locked' in str(error)
+
+def _begin_write(conn):
+    """
+    BEGIN IMMEDIATE：开始时就拿到写锁，事务中途不会因为升级锁失败而报错。
+    读不受影响：WAL 模式下读者不需要锁，始终能读到最近一次提交的快照。
+    busy_timeout 耗尽后按 BUSY_RETRIES 随机退避重试，等待时间和重试次数记入 instrument。
+    """
+    retries = config.get_int('database', 'busy_retries', BUSY_RETRIES)
+    start = time.perf_counter()
+    attempt = 0
+    while True:
+        try:
+            conn.execute("BEGIN IMMEDIATE;")
+            break
+        except sqlite3.OperationalError as e:
+            if not _is_busy(e) or attempt >= retries:
+                instrument.record_lock_wait(time.perf_counter() - start, attempt, failed=True)
+                raise
+            attempt += 1
+            # 只有发生冲突时才用得到，不拖慢启动
+            import random
+            backoff = config.get_int('database', 'busy_backoff_ms', BUSY_BACKOFF_MS)
+            time.sleep(random.uniform(0, backoff * 2 ** attempt) / 1000)
+    instrument.record_lock_wait(time.perf_counter() - start, attempt)
+
+@contextlib.contextmanager
+def transaction():
+    """
+    写事务。db 模块所有的写操作都在它里面执行。
+    最外层负责 BEGIN / COMMIT，出错时整体 ROLLBACK；嵌套调用改用 SAVEPOINT，
+    内层出错只撤销它自己的修改。观察者通知在最外层提交后才发出，见 _notify。
+    因此可以把多个写操作合并成一次提交：
+
+        with db.transaction():
+            db.add_todo('a')
+            db.update_todo_status(1, 1)
+    """
+    conn = get_db()
+    depth = getattr(_local, 'tx_depth', 0)
+    _local.tx_depth = depth + 1
+    pending = None
+    try:
+        if depth == 0:
+            if not conn.in_transaction:
+                _begin_write(conn)
+            pending = _local.pending = []
+            try:
+                yield conn
+                conn.commit()
+            except BaseException:
+                conn.rollback()
+                raise
+            finally:
+                _local.pending = None
+                _bump_generation()
+        else:
+            savepoint = f"sp_{depth}"
+            mark = len(_local.pending)
+            conn.execute(f"SAVEPOINT {savepoint};")
+            try:
+                yield conn
+            except BaseException:
+                conn.execute(f"ROLLBACK TO {savepoint};")
+                conn.execute(f"RELEASE {savepoint};")
+                del _local.pending[mark:]
+                raise
+            conn.execute(f"RELEASE {savepoint};")
+    finally:
+        _local.tx_depth = depth
+    if depth == 0:
+        # 走到这里说明已经提交
+        for event, args, kwargs in pending:
+            _deliver(event, args, kwargs)
+        _maybe_checkpoint()
+
+def _execute_returning(sql, params=()):
+    """
+    执行一条带 RETURNING 子句的写语句，所有单行写操作都经过这里。
+    在提交前取回受影响的那一行 Task，没有命中任何行时返回 None
+    """
+    with transaction() as conn:
+        cursor = _task_cursor(conn)
+        cursor.execute(sql, params)
+        task = cursor.fetchone()
+        cursor.fetchall()  # 把语句执行完，之后才能提交
+    return task
+
+def get_db():
+    """
+    获取当前线程的数据库连接。
+    第一次调用时才会打开（或从空闲池中取出）连接，之后一直复用同一个。
+    注意：不要写 `with get_db() as conn:`，退出时它会提交当前线程正在进行的事务；写操作请用 transaction()。
+    """
+    conn = getattr(_local, 'conn', None)
+    if conn is None:
+        with _pool_lock:
+            conn = _idle_conns.pop() if _idle_conns else None
+        if conn is None:
+            conn = _connect()
+        _local.conn = conn
     return conn
 
+def release_db():
+    """
+    把当前线程的连接还回空闲池。
+    工作线程结束前调用它，后来的线程就能直接复用连接。
+    """
+    conn = getattr(_local, 'conn', None)
+    if conn is None:
+        return
+    _local.conn = None
+    with _pool_lock:
+        if len(_idle_conns) < POOL_SIZE:
+            _idle_conns.append(conn)
+            return
+    _close(conn)
+
+def close_db():
+    """
+    关闭当前线程的连接以及池中所有空闲连接，进程退出时自动调用。
+    之后再访问数据库会重新打开连接并检查结构，内存模式下就是一个新的空数据库（或重新载入快照）。
+    """
+    global _schema_ready
+    conn = getattr(_local, 'conn', None)
+    _local.conn = None
+    if conn is not None:
+        _close(conn)
+    with _pool_lock:
+        while _idle_conns:
+            _close(_idle_conns.pop())
+    _close_memory_anchor()
+    with _schema_lock:
+        _schema_ready = None
+
+def _close_memory_anchor():
+    global _memory_anchor
+    with _memory_lock:
+        if _memory_anchor is None:
+            return
+        try:
+            _save_memory_snapshot()
+        finally:
+            _memory_anchor.close()
+            _memory_anchor = None
+
+def _close(conn):
+    # id 可能被之后新建的连接复用，关闭时把它记录的 data_version 一起删掉
+    with _generation_lock:
+        _data_versions.pop(id(conn), None)
+    conn.close()
+
+atexit.register(close_db)
+
+
+class Task(namedtuple('Task', ['task_id', 'content', 'is_done', 'created_at', 'deadline'])):
+    """
+    一条任务记录，字段顺序与查询语句中的列顺序一致。
+    固定布局的元组，没有 __dict__，比每行一个 dict 省内存也省 GC。
+    """
+    __slots__ = ()
+
+_make_task = Task._make
+# 查询任务时选取的列，交给 query.select
+TASK_COLUMNS = Task._fields
+
+def _task_row(cursor, row):
+    """row_factory：把查询结果直接构造成 Task，中间不经过 sqlite3.Row 或 dict"""
+    return _make_task(row)
+
+def _task_cursor(conn):
+    """返回一个产出 Task 的游标，只用于选取任务列的查询"""
+    cursor = conn.cursor()
+    cursor.row_factory = _task_row
+    return cursor
+
+def add_observer(observer):
+    """
+    注册一个观察者，本进程内每次成功的写操作之后都会通知它：
+      put(task)                任务被添加或修改，task 是修改后的 Task
+      update(task_ids, **kv)   批量修改了这些任务的字段
+      remove(task_ids)         这些任务被删除
+      invalidate()             发生了无法逐行描述的变化，需要重新加载
+    """
+    if observer not in _observers:
+        _observers.append(observer)
+
+def remove_observer(observer):
+    if observer in _observers:
+        _observers.remove(observer)
+
+def invalidate_observers():
+    """通知所有观察者丢弃已有状态，例如一批写操作最终没有提交成功时"""
+    _notify('invalidate')
+
+def _notify(event, *args, **kwargs):
+    """
+    把一次写操作通知给所有观察者。在 transaction() 里时先排队，最外层提交之后才发出；
+    整个事务或某个 SAVEPOINT 回滚时，对应的通知一起丢掉，观察者看不到没有生效的修改。
+    invalidate 总是立即发出，多丢弃一次状态没有坏处。
+    """
+    pending = getattr(_local, 'pending', None)
+    if pending is not None and event != 'invalidate':
+        pending.append((event, args, kwargs))
+        return
+    _deliver(event, args, kwargs)
+
+def _deliver(event, args, kwargs):
+    for observer in list(_observers):
+        getattr(observer, event)(*args, **kwargs)
+
+def _get_result_cache():
+    global _result_cache
+    if _result_cache is None:
+        max_rows = config.get_int('cache', 'max_rows', RESULT_CACHE_ROWS)
+        if max_rows <= 0:
+            _result_cache = False
+        else:
+            from .cache import ResultCache
+            _result_cache = ResultCache(max_rows, config.get_int('cache', 'max_entries', RESULT_CACHE_ENTRIES))
+    return _result_cache
+
+def _bump_generation():
+    global _generation
+    with _generation_lock:
+        _generation += 1
+
+def _current_generation(conn):
+    """
+    当前代号；先用 PRAGMA data_version 检查有没有别的连接（包括其他进程）提交过。
+    有的话观察者（任务缓存等）收到的增量通知不完整，同时通知它们丢弃已有状态。
+    """
+    global _generation
+    version = conn.execute("PRAGMA data_version;").fetchone()[0]
+    with _generation_lock:
+        changed = _data_versions.get(id(conn)) != version
+        if changed:
+            # 第一次见到的连接无法知道之前发生过什么，同样当作有变化
+            _data_versions[id(conn)] = version
+            _generation += 1
+        generation = _generation
+    if changed:
+        _notify('invalidate')
+    return generation
+
+def _freeze(value):
+    """把参数中的列表转成元组，才能作为缓存的键"""
+    if isinstance(value, (list, tuple)):
+        return tuple(_freeze(item) for item in value)
+    return value
+
+def _cached_result(cacheable=None):
+    """
+    读函数的结果缓存。键是函数名加全部参数；事务进行中的读取不缓存，因为看到的可能是未提交的数据。
+    cacheable 的参数与被装饰的函数相同，返回 False 时这次调用直接查询，
+    用于结果依赖当前时间、或者结果只会被用一次（如分页的后续页）的情况。
+    重复的查询命中时只花一次 PRAGMA data_version 的时间。
+    """
+    def decorator(func):
+        name = func.__name__
+
+        @functools.wraps(func)
+        def wrapper(*args, **kwargs):
+            cache = _get_result_cache()
+            conn = get_db()
+            if not cache or conn.in_transaction or (cacheable is not None and not cacheable(*args, **kwargs)):
+                return func(*args, **kwargs)
+            key = (name, _freeze(args), _freeze(tuple(sorted(kwargs.items()))))
+            generation = _current_generation(conn)
+            hit, value = cache.get(key, generation)
+            if not hit:
+                value = func(*args, **kwargs)
+                cache.put(key, generation, value)
+            return value
+        return wrapper
+    return decorator
+
+def result_cache_stats():
+    """结果缓存的条目数、行数和命中情况，缓存关闭时返回 None"""
+    cache = _get_result_cache()
+    return cache.stats() if cache else None
+
+def enable_task_cache():
+    """
+    启用任务列表缓存。之后 get_all_todos 只在第一次访问数据库，
+    本进程内的增删改会直接更新缓存，不必重新读取整张表；别的进程改过数据库时整体重新读取。
+    """
+    global _task_cache
+    if _task_cache is None:
+        from .cache import TaskCache
+        _task_cache = TaskCache()
+        add_observer(_task_cache)
+    return _task_cache
+
+def _list_migrations():
+    """列出随包安装的迁移脚本，返回按版本号排序的 [(version, resource), ...]"""
+    from importlib import resources
+    migrations = []
+    for entry in resources.files(MIGRATIONS_PACKAGE).joinpath(MIGRATIONS_DIR).iterdir():
+        match = _MIGRATION_NAME.match(entry.name)
+        if match:
+            migrations.append((int(match.group(1)), entry))
+    migrations.sort(key=lambda item: item[0])
+    return migrations
+
+def _migrate(conn):
+    """
+    按 PRAGMA user_version 记录的版本，只执行尚未应用的迁移脚本。
+    版本已经是 SCHEMA_VERSION 时只读一次 user_version，不碰任何文件也不执行 DDL。
+    """
+    current = conn.execute("PRAGMA user_version;").fetchone()[0]
+    if current >= SCHEMA_VERSION:
+        return
+
+    # user_version 为 0 不一定是空库：基线版本的 schema.sql 建出来的数据库也是 0，里面已经有数据
+    # （0001 因此用了 IF NOT EXISTS）。只有还没有 todo 表的全新数据库才在建表之前开启增量 vacuum，
+    # 归档、删除释放的页之后可以逐步归还给文件系统；设置 WAL 时文件已经创建，要 VACUUM 一次才生效，
+    # 库是空的，代价可以忽略。旧数据库第一次 reclaim_space() 时才切换，不在启动时做完整的 VACUUM
+    if current == 0 and conn.execute(
+            "SELECT 1 FROM sqlite_master WHERE type = 'table' AND name = 'todo';").fetchone() is None:
+        conn.execute("PRAGMA auto_vacuum = INCREMENTAL;")
+        conn.execute("VACUUM;")
+
+    # 迁移脚本里可以用 normalize_timestamp()，规则与写入时相同，见 0007
+    conn.create_function('normalize_timestamp', 1, _normalize_or_keep, deterministic=True)
+    applied = None
+    for version, entry in _list_migrations():
+        if version <= current:
+            continue
+        # 每个迁移和版本号的更新放在同一个写事务里，失败时整体回滚。
+        # 拿到写锁后重新读一次版本：多个进程同时升级时，只有第一个会真正执行
+        _begin_write(conn)
+        try:
+            current = conn.execute("PRAGMA user_version;").fetchone()[0]
+            if version > current:
+                for statement in _split_statements(entry.read_text(encoding='utf-8')):
+                    conn.execute(statement)
+                conn.execute(f"PRAGMA user_version = {version};")
+                applied = current = version
+            conn.commit()
+        except BaseException:
+            conn.rollback()
+            raise
+    if applied is not None:
+        _report(f"数据库已升级到版本 {applied}！")
+
+def _split_statements(script):
+    """
+    把迁移脚本拆成单条语句。executescript 会先提交当前事务，没法在持有写锁时执行，
+    所以逐条 execute；sqlite3.complete_statement 能正确处理触发器中的分号。
+    """
+    statement = ''
+    for line in script.splitlines(keepends=True):
+        statement += line
+        if sqlite3.complete_statement(statement):
+            yield statement
+            statement = ''
+
+def _ensure_schema(conn):
+    """每个数据库只在本进程打开第一个连接时检查一次结构"""
+    global _schema_ready
+    path = database_path()
+    if _schema_ready == path:
+        return
+    with _schema_lock:
+        if _schema_ready != path:
+            _migrate(conn)
+            _schema_ready = path
+
+def normalize_timestamp(value):
+    """
+    把用户输入的时间统一成 TIMESTAMP_FORMAT，None 和空字符串返回 None，无法识别时抛出 ValueError。
+    所有时间字段都是这个格式，字符串的大小顺序就是时间顺序，范围查询可以直接走索引。
+    带时区的输入换算成本地时间，与用户输入的截止日期一致。
+    """
+    if value is None or value == '':
+        return None
+    from datetime import datetime
+    if not isinstance(value, datetime):
+        text = str(value).strip()
+        try:
+            value = datetime.fromisoformat(text)
+        except ValueError:
+            for fmt in TIMESTAMP_INPUT_FORMATS:
+                try:
+                    value = datetime.strptime(text, fmt)
+                    break
+                except ValueError:
+                    continue
+            else:
+                raise ValueError(f"无法识别的时间 {text!r}，请使用 YYYY-MM-DD HH:MM:SS 格式") from None
+    if value.tzinfo is not None:
+        value = value.astimezone().replace(tzinfo=None)
+    return value.strftime(TIMESTAMP_FORMAT)
+
+def _normalize_or_keep(value):
+    """迁移脚本用的 SQL 函数：能识别的时间改写成 TIMESTAMP_FORMAT，空值和识别不了的值原样返回"""
+    if value is None or value == '':
+        return value
+    try:
+        return normalize_timestamp(value)
+    except ValueError:
+        return value
+
 def init_db():
     """
-    初始化数据库：根据 schema.sql 文件创建表。
+    初始化数据库，确保结构是最新版本，已有数据不会丢失。
+    不调用它也可以：第一次打开连接时会自动完成同样的检查。
     """
-    with get_db() as conn:
-        with open(SCHEMA_PATH, 'r', encoding='utf-8') as f:
-            conn.executescript(f.read())
-    print("数据库已成功初始化！")
+    get_db()
+
+# 写语句用 RETURNING 取回的列，与 Task 的字段一一对应
+_RETURNING = " RETURNING task_id, content, is_done, created_at, deadline;"
 
-def add_todo(content, deadline=None):
-    """向数据库中添加一个新的待办事项"""
+def add_todo(content, deadline=None, tags=()):
+    """向数据库中添加一个新的待办事项，返回新建的 Task；tags 是要打上的标签名"""
     # 模板和数据是分开的
-    sql = "INSERT INTO todo (content, deadline) VALUES (?, ?);"
-    with get_db() as conn:
-        conn.execute(sql, (content, deadline))
-    print(f"已添加待办事项：'{content}'")
+    sql = "INSERT INTO todo (content, deadline) VALUES (?, ?)" + _RETURNING
+    deadline = normalize_timestamp(deadline)
+    tags = normalize_tags(tags)
+    with transaction():
+        task = _execute_returning(sql, (content, deadline))
+        if tags:
+            _link_tags([task.task_id], tags)
+    _notify('put', task)
+    _report(f"已添加待办事项：'{content}'")
+    return task
 
+@_cached_result()
 def get_all_todos():
-    """从数据库中获取所有的待办事项"""
-    sql = "SELECT task_id, content, is_done, created_at, deadline FROM todo ORDER BY created_at DESC;"
-    with get_db() as conn:
-        cursor = conn.cursor()
+    """从数据库中获取所有的待办事项；启用缓存后直接返回缓存内容，别的进程改过数据库时重新读取"""
+    conn = get_db()
+    # 事务里看到的是未提交的数据，既不能用缓存回答，也不能拿来填充缓存
+    use_cache = _task_cache is not None and not conn.in_transaction
+    if use_cache:
+        # 发现别的连接提交过时会通知 _task_cache 丢弃内容；加载前调用一次，记下这时的 data_version
+        _current_generation(conn)
+        if _task_cache.loaded:
+            return _task_cache.tasks()
+
+    sql = query.select('todo', TASK_COLUMNS, order_by="todo.created_at DESC, todo.task_id DESC")
+    cursor = _task_cursor(conn)
+    cursor.execute(sql)
+    # fetchall() 获取所有查询结果，每一行已经是 Task
+    tasks = cursor.fetchall()
+    if use_cache:
+        _task_cache.load(tasks)
+    return tasks
+
+@_cached_result()
+def count_todos(status=None):
+    """统计任务数量，status 为 None 时统计全部；读的是触发器维护的 todo_stats，与任务总数无关"""
+    if status is None:
+        row = get_db().execute("SELECT COALESCE(SUM(task_count), 0) FROM todo_stats;").fetchone()
+    else:
+        row = get_db().execute("SELECT COALESCE(SUM(task_count), 0) FROM todo_stats WHERE is_done = ?;",
+                               (status,)).fetchone()
+    return row[0]
+
+def summary(now=None, soon_hours=DUE_SOON_HOURS):
+    """
+    任务概况：未完成 / 已完成数量，以及未完成任务中已逾期、即将到期的数量。
+    now: 'YYYY-MM-DD HH:MM:SS' 格式的当前时间，默认取本地时间
+    soon_hours: 多少小时内到期算作即将到期
+    数量来自 todo_stats，逾期与即将到期是 idx_todo_is_done_deadline 上的两次范围计数。
+    """
+    from datetime import datetime, timedelta
+    now_dt = datetime.now() if now is None else datetime.strptime(now, TIMESTAMP_FORMAT)
+    now = now_dt.strftime(TIMESTAMP_FORMAT)
+    soon = (now_dt + timedelta(hours=soon_hours)).strftime(TIMESTAMP_FORMAT)
+
+    conn = get_db()
+    counts = dict(conn.execute("SELECT is_done, task_count FROM todo_stats;").fetchall())
+    overdue = conn.execute("SELECT COUNT(*) FROM todo WHERE is_done = 0 AND deadline < ?;",
+                           (now,)).fetchone()[0]
+    due_soon = conn.execute("SELECT COUNT(*) FROM todo WHERE is_done = 0 AND deadline >= ? AND deadline < ?;",
+                            (now, soon)).fetchone()[0]
+    return {
+        'open': counts.get(0, 0),
+        'done': counts.get(1, 0),
+        'overdue': overdue,
+        'due_soon': due_soon,
+    }
+
+def get_upcoming_deadlines(after):
+    """
+    返回截止日期晚于 after 的未完成任务，按截止日期升序。
+    after 与 deadline 使用同样的 'YYYY-MM-DD HH:MM:SS' 格式，查询走 idx_todo_is_done_deadline 范围扫描。
+    """
+    sql = query.select('todo', TASK_COLUMNS, ("todo.is_done = 0", "todo.deadline > ?"),
+                       order_by="todo.deadline")
+    conn = get_db()
+    cursor = _task_cursor(conn)
+    cursor.execute(sql, (after,))
+    return cursor.fetchall()
+
+# 只缓存第一页：后续页通常是 iter_todos 式的一次性遍历，缓存下来只会挤掉常用的条目
+@_cached_result(cacheable=lambda limit, after=None, status=None: after is None)
+def get_todos_page(limit, after=None, status=None):
+    """
+    keyset 分页：按 created_at、task_id 倒序，返回排在 after 之后的最多 limit 个任务。
+    after: 上一页最后一个任务的 (created_at, task_id)，为 None 时返回第一页
+    status: 0 for 未完成, 1 for 已完成，为 None 时不过滤
+    """
+    filters = []
+    params = []
+
+    if status is not None:
+        filters.append("todo.is_done = ?")
+        params.append(status)
+
+    if after is not None:
+        # 行值比较可以直接利用 (created_at DESC, task_id DESC) 索引定位，不需要 OFFSET
+        filters.append("(todo.created_at, todo.task_id) < (?, ?)")
+        params.extend(after)
+
+    sql = query.select('todo', TASK_COLUMNS, tuple(filters),
+                       order_by="todo.created_at DESC, todo.task_id DESC", limit=True)
+    params.append(limit)
+
+    conn = get_db()
+    cursor = _task_cursor(conn)
+    cursor.execute(sql, tuple(params))
+    return cursor.fetchall()
+
+def iter_export_batches(batch_size=EXPORT_BATCH_SIZE):
+    """
+    按 task_id 顺序分批产出 todo 表的全部行（EXPORT_COLUMNS 顺序的普通元组），用于导出。
+    只有一条 SELECT，用 fetchmany 取数据：内存里最多一批，WAL 模式下整个导出看到的是同一个快照。
+    """
+    sql = f"SELECT {', '.join(EXPORT_COLUMNS)} FROM todo ORDER BY task_id;"
+    cursor = get_db().cursor()
+    # 不需要列名访问，普通元组比 sqlite3.Row 更省
+    cursor.row_factory = None
+    try:
         cursor.execute(sql)
-        # fetchall() 获取所有查询结果
-        results = cursor.fetchall()
-        # fetchall() 返回的是一个元组列表，我们把它转成字典列表，方便使用
-        return [dict(row) for row in results]
+        while True:
+            rows = cursor.fetchmany(batch_size)
+            if not rows:
+                return
+            yield rows
+    finally:
+        # 生成器提前关闭时也要结束这条语句，否则读事务会一直挂着
+        cursor.close()
+
+def iter_todos(status=None, page_size=PAGE_SIZE):
+    """
+    逐个产出任务的生成器，顺序与 get_all_todos 相同。
+    内部按页读取，任何时候内存里最多只有一页数据；读到的页不放进结果缓存。
+    """
+    read_page = get_todos_page.__wrapped__
+    after = None
+    while True:
+        page = read_page(page_size, after, status)
+        yield from page
+        if len(page) < page_size:
+            return
+        last = page[-1]
+        after = (last.created_at, last.task_id)
 
 def update_todo_status(task_id, is_done):
-    """更新指定ID任务的完成状态"""
-    sql = "UPDATE todo SET is_done = ? WHERE task_id = ?;"
-    with get_db() as conn:
-        conn.execute(sql, (is_done, task_id))
-    print(f"已更新任务 {task_id} 的状态。")
+    """更新指定ID任务的完成状态，返回更新后的 Task；任务不存在时返回 None"""
+    sql = "UPDATE todo SET is_done = ? WHERE task_id = ?" + _RETURNING
+    task = _execute_returning(sql, (is_done, task_id))
+    if task is not None:
+        _notify('put', task)
+    _report(f"已更新任务 {task_id} 的状态。")
+    return task
 
 def delete_todo(task_id):
-    """根据ID删除一个任务"""
+    """根据ID删除一个任务，返回被删除的 Task；任务不存在时返回 None"""
+    sql = "DELETE FROM todo WHERE task_id = ?" + _RETURNING
+    task = _execute_returning(sql, (task_id,))
+    if task is not None:
+        _notify('remove', [task_id])
+    _report(f"已删除任务 {task_id}。")
+    return task
+
+def _chunks(iterable, size):
+    """把任意可迭代对象切成长度不超过 size 的列表，不会一次性读完整个输入"""
+    chunk = []
+    for item in iterable:
+        chunk.append(item)
+        if len(chunk) >= size:
+            yield chunk
+            chunk = []
+    if chunk:
+        yield chunk
+
+def _executemany_chunked(sql, rows, chunk_size):
+    """在同一个事务里分块执行 executemany，返回受影响的总行数"""
+    total = 0
+    with transaction() as conn:
+        for chunk in _chunks(rows, chunk_size):
+            total += conn.executemany(sql, chunk).rowcount
+    return total
+
+def add_todos(todos, chunk_size=CHUNK_SIZE):
+    """
+    批量添加待办事项，所有行在一个事务中提交。
+    todos: 可迭代对象，每一项是 (content, deadline)，deadline 可以为 None
+    返回添加的任务数量
+    """
+    sql = "INSERT INTO todo (content, deadline) VALUES (?, ?);"
+    rows = ((content, normalize_timestamp(deadline)) for content, deadline in todos)
+    count = _executemany_chunked(sql, rows, chunk_size)
+    # 批量插入拿不到每一行的内容，只能让观察者重新加载
+    _notify('invalidate')
+    _report(f"已批量添加 {count} 个待办事项。")
+    return count
+
+def set_status_many(task_ids, is_done, chunk_size=CHUNK_SIZE):
+    """批量更新多个任务的完成状态，返回实际更新的数量"""
+    sql = "UPDATE todo SET is_done = ? WHERE task_id = ?;"
+    if _observers:
+        task_ids = list(task_ids)
+    count = _executemany_chunked(sql, ((is_done, task_id) for task_id in task_ids), chunk_size)
+    _notify('update', task_ids, is_done=is_done)
+    _report(f"已更新 {count} 个任务的状态。")
+    return count
+
+def delete_many(task_ids, chunk_size=CHUNK_SIZE):
+    """批量删除多个任务，返回实际删除的数量"""
     sql = "DELETE FROM todo WHERE task_id = ?;"
-    with get_db() as conn:
-        conn.execute(sql, (task_id,))
-    print(f"已删除任务 {task_id}。")
+    if _observers:
+        task_ids = list(task_ids)
+    count = _executemany_chunked(sql, ((task_id,) for task_id in task_ids), chunk_size)
+    _notify('remove', task_ids)
+    _report(f"已删除 {count} 个任务。")
+    return count
+
+def normalize_tags(names):
+    """去掉标签名前面的 #，去重（不区分大小写）并检查格式，返回列表；格式不对时抛出 ValueError"""
+    result = []
+    for name in names:
+        name = name.strip().lstrip('#')
+        if not _TAG_NAME.fullmatch(name):
+            raise ValueError(f"标签名不合法：{name!r}（不能为空，不能包含空白或 #）")
+        if name.lower() not in (n.lower() for n in result):
+            result.append(name)
+    return result
+
+def _link_tags(task_ids, names):
+    """在已有的事务里给任务打标签，返回新增的关联数量；不存在的任务 ID 会被忽略"""
+    conn = get_db()
+    conn.executemany("INSERT OR IGNORE INTO tag (name) VALUES (?);", [(name,) for name in names])
+    sql = ("INSERT OR IGNORE INTO todo_tag (tag_id, task_id)"
+           " SELECT tag.tag_id, todo.task_id FROM tag, todo WHERE tag.name = ? AND todo.task_id = ?;")
+    return conn.executemany(sql, [(name, task_id) for task_id in task_ids for name in names]).rowcount
+
+def tag_todos(task_ids, names):
+    """给多个任务打上同一组标签，返回新增的关联数量"""
+    names = normalize_tags(names)
+    with transaction():
+        count = _link_tags(list(task_ids), names)
+    _report(f"已添加 {count} 个标签。")
+    return count
+
+def untag_todos(task_ids, names):
+    """去掉多个任务上的一组标签，返回删除的关联数量"""
+    names = normalize_tags(names)
+    sql = ("DELETE FROM todo_tag WHERE task_id = ?"
+           " AND tag_id = (SELECT tag_id FROM tag WHERE name = ?);")
+    count = _executemany_chunked(sql, ((task_id, name) for task_id in task_ids for name in names), CHUNK_SIZE)
+    _report(f"已去掉 {count} 个标签。")
+    return count
+
+@_cached_result()
+def get_tags(task_id):
+    """任务的标签名列表，按名字排序"""
+    sql = ("SELECT tag.name FROM todo_tag JOIN tag ON tag.tag_id = todo_tag.tag_id"
+           " WHERE todo_tag.task_id = ? ORDER BY tag.name;")
+    return [name for (name,) in get_db().execute(sql, (task_id,))]
+
+@_cached_result()
+def tag_counts():
+    """每个标签的任务数量和其中未完成的数量，按名字排序；读的是触发器维护的计数"""
+    sql = "SELECT name, task_count, open_count FROM tag WHERE task_count > 0 ORDER BY name;"
+    return [{'name': name, 'tasks': tasks, 'open': open_}
+            for name, tasks, open_ in get_db().execute(sql)]
+
+def import_hashtags(chunk_size=CHUNK_SIZE):
+    """
+    一次性把 content 里写的 #标签 转成真正的标签，content 本身不变，返回新增的关联数量。
+    用于有了标签表之前用 #标签 写法的数据，需要全表扫描一次。
+    """
+    cursor = get_db().cursor()
+    cursor.row_factory = None
+    cursor.execute("SELECT task_id, content FROM todo WHERE content LIKE '%#%';")
+    links = [(task_id, name) for task_id, content in cursor.fetchall()
+             for name in normalize_tags(_HASHTAG.findall(content))]
+    count = 0
+    with transaction() as conn:
+        conn.executemany("INSERT OR IGNORE INTO tag (name) VALUES (?);", {(name,) for _, name in links})
+        for chunk in _chunks(links, chunk_size):
+            count += conn.executemany(
+                "INSERT OR IGNORE INTO todo_tag (tag_id, task_id)"
+                " SELECT tag_id, ? FROM tag WHERE name = ?;", chunk).rowcount
+    _report(f"已从任务内容中识别出 {count} 个标签。")
+    return count
+
+def last_change():
+    """变更日志中最新的序号，还没有任何变更时返回 0"""
+    return get_db().execute("SELECT COALESCE(MAX(seq), 0) FROM todo_changes;").fetchone()[0]
+
+def _change(seq, task_id, *row):
+    """iter_changes 的一行结果：任务还在 todo 里是修改，在 todo_archive 里是归档，都不在就是删除"""
+    live, archived = row[:len(EXPORT_COLUMNS)], row[len(EXPORT_COLUMNS):]
+    if live[0] is not None:
+        return seq, task_id, CHANGE_UPSERT, live
+    if archived[0] is not None:
+        return seq, task_id, CHANGE_ARCHIVE, archived
+    return seq, task_id, CHANGE_DELETE, None
+
+def changes_floor():
+    """变更日志已经清理到的序号，序号不大于它的变更都已删除；从没清理过时返回 0"""
+    return get_db().execute("SELECT seq FROM todo_changes_floor WHERE id = 1;").fetchone()[0]
+
+def iter_changes(since=0, batch_size=EXPORT_BATCH_SIZE):
+    """
+    按序号顺序分批产出 since 之后变过的任务，每项是 (seq, task_id, kind, row)。
+    kind 是 CHANGE_UPSERT / CHANGE_ARCHIVE / CHANGE_DELETE；row 是任务当前的内容（EXPORT_COLUMNS 顺序的元组，
+    归档的任务取 todo_archive 里的内容），删除时为 None。
+    归档在变更日志里也是一次删除，要看任务是否在 todo_archive 里才能区分，副本据此归档而不是删掉任务。
+    同一个任务多次变更只产出一次，序号取最后一次；读取量只与变更数量有关。
+    变更日志清理过（见 prune_changes）时，since 为 0 改为产出 todo 和 todo_archive 里的全部任务，
+    变更记录已被清理的任务序号记为清理到的序号；0 < since < 清理到的序号时缺了一段，抛出 ValueError。
+    """
+    floor = changes_floor()
+    if 0 < since < floor:
+        raise ValueError(f"序号 {floor} 及之前的变更记录已经清理，无法从 {since} 开始增量导出，"
+                         f"请用 --since 0 做一次完整导出")
+    if since == 0 and floor > 0:
+        changed = ("(SELECT task_id, MAX(seq) AS seq FROM"
+                   " (SELECT task_id, :floor AS seq FROM todo"
+                   " UNION ALL SELECT task_id, :floor FROM todo_archive"
+                   " UNION ALL SELECT task_id, seq FROM todo_changes) GROUP BY task_id)")
+    else:
+        changed = "(SELECT task_id, MAX(seq) AS seq FROM todo_changes WHERE seq > :since GROUP BY task_id)"
+    return _iter_changes(changed, {'since': since, 'floor': floor}, batch_size)
+
+def _iter_changes(changed, params, batch_size):
+    """iter_changes 的生成器部分，检查放在外面，since 不对时调用就报错，不必等到开始遍历"""
+    columns = ', '.join([f'todo.{c}' for c in EXPORT_COLUMNS] + [f'todo_archive.{c}' for c in EXPORT_COLUMNS])
+    sql = (f"SELECT c.seq, c.task_id, {columns} FROM {changed} AS c"
+           " LEFT JOIN todo ON todo.task_id = c.task_id"
+           " LEFT JOIN todo_archive ON todo_archive.task_id = c.task_id ORDER BY c.seq;")
+    cursor = get_db().cursor()
+    cursor.row_factory = None
+    try:
+        cursor.execute(sql, params)
+        while True:
+            rows = cursor.fetchmany(batch_size)
+            if not rows:
+                return
+            yield [_change(*row) for row in rows]
+    finally:
+        cursor.close()
+
+def apply_changes(changes, chunk_size=CHUNK_SIZE):
+    """
+    应用 iter_changes 产出的 (task_id, kind, row) 变更：修改按 task_id 写入或覆盖 todo，
+    归档把任务写入 todo_archive 并从 todo 中移除，删除只从 todo 中移除。
+    全部在一个事务中提交，返回 (写入数量, 归档数量, 删除数量)。
+    """
+    columns = ', '.join(EXPORT_COLUMNS)
+    placeholders = ', '.join('?' for _ in EXPORT_COLUMNS)
+    updates = ', '.join(f'{c} = excluded.{c}' for c in EXPORT_COLUMNS[1:])
+    upsert_sql = (f"INSERT INTO todo ({columns}) VALUES ({placeholders})"
+                  f" ON CONFLICT (task_id) DO UPDATE SET {updates};")
+    archive_sql = (f"INSERT INTO todo_archive ({columns}) VALUES ({placeholders})"
+                   f" ON CONFLICT (task_id) DO UPDATE SET {updates};")
+    delete_sql = "DELETE FROM todo WHERE task_id = ?;"
+    upserted = archived = deleted = 0
+    with transaction() as conn:
+        for chunk in _chunks(changes, chunk_size):
+            rows = [row for _, kind, row in chunk if kind == CHANGE_UPSERT]
+            moved = [row for _, kind, row in chunk if kind == CHANGE_ARCHIVE]
+            gone = [(task_id,) for task_id, kind, _ in chunk if kind == CHANGE_DELETE]
+            if rows:
+                upserted += conn.executemany(upsert_sql, rows).rowcount
+            if moved:
+                archived += conn.executemany(archive_sql, moved).rowcount
+                conn.executemany(delete_sql, [(row[0],) for row in moved])
+            if gone:
+                deleted += conn.executemany(delete_sql, gone).rowcount
+    _notify('invalidate')
+    _report(f"已同步 {upserted} 个任务，归档 {archived} 个任务，删除 {deleted} 个任务。")
+    return upserted, archived, deleted
+
+def prune_changes(before_seq):
+    """
+    删除序号不大于 before_seq 的变更记录（所有副本都已同步过的部分），返回删除的数量。
+    清理到的序号记在 todo_changes_floor 里，之后从更早的序号增量导出会报错；
+    before_seq 超过已经分配的最大序号时只记到最大序号，之后产生的变更不受影响。
+    """
+    with transaction() as conn:
+        count = conn.execute("DELETE FROM todo_changes WHERE seq <= ?;", (before_seq,)).rowcount
+        conn.execute(
+            "UPDATE todo_changes_floor SET seq = MAX(seq, MIN(?,"
+            " COALESCE((SELECT seq FROM sqlite_sequence WHERE name = 'todo_changes'), 0)))"
+            " WHERE id = 1;", (before_seq,))
+    _report(f"已清理 {count} 条变更记录。")
+    return count
 
 def edit_todo(task_id, content=None, start_at=None, deadline=None):
     """
     通用的编辑函数，可以修改任务的任意一个或多个字段。
+    返回更新后的 Task；任务不存在或没有需要修改的内容时返回 None
     """
-    # 这是一个非常常见的模式：动态构建UPDATE语句
-    set_clauses = []
+    # 只更新传入的字段；每种字段组合对应一条固定的语句，由 query.update 缓存
+    fields = []
     params = []
 
     if content is not None:
-        set_clauses.append("content = ?")
+        fields.append('content')
         params.append(content)
     
     if start_at is not None:
-        set_clauses.append("start_at = ?")
-        params.append(start_at)
+        fields.append('start_at')
+        params.append(normalize_timestamp(start_at))
 
     if deadline is not None:
-        set_clauses.append("deadline = ?")
-        params.append(deadline)
+        fields.append('deadline')
+        params.append(normalize_timestamp(deadline))
 
     # 如果用户什么都没传，就没必要执行更新
-    if not set_clauses:
-        print("没有提供任何需要修改的内容。")
-        return
+    if not fields:
+        _report("没有提供任何需要修改的内容。")
+        return None
 
-    # 用逗号把所有 'key = ?' 拼接起来
-    sql = f"UPDATE todo SET {', '.join(set_clauses)} WHERE task_id = ?;"
+    sql = query.update('todo', tuple(fields), returning=TASK_COLUMNS)
     
-    # 别忘了把 task_id 加到参数列表的最后，对应 WHERE id = ?
+    # 别忘了把 task_id 加到参数列表的最后，对应 WHERE task_id = ?
     params.append(task_id)
 
-    with get_db() as conn:
-        conn.execute(sql, tuple(params))
-    print(f"任务 {task_id} 已更新。")
+    task = _execute_returning(sql, tuple(params))
+    if task is not None:
+        _notify('put', task)
+    _report(f"任务 {task_id} 已更新。")
+    return task
+
+def _fts_phrase(text):
+    """把用户输入包装成 FTS5 短语，避免其中的引号、AND/OR 等被当成查询语法"""
+    return '"' + text.replace('"', '""') + '"'
 
 # 我们可以创建一个新的 find_todos 函数，或者直接增强 get_all_todos
 # 为了清晰，我们先创建一个新的
-def find_todos(status=None, text_search=None):
+# started 条件没有给出 now 时取当前时间，结果随时间变化，不能缓存
+@_cached_result(cacheable=lambda *args, started=None, now=None, **kwargs: started is None or now is not None)
+def find_todos(status=None, text_search=None, include_archive=False, *,
+               due_before=None, due_after=None, started=None, now=None, tags=()):
     """
     根据不同条件查找任务。
     status: 0 for 未完成, 1 for 已完成
-    text_search: 在 content 字段中进行模糊搜索
+    text_search: 在 content 字段中进行全文搜索，结果按相关度排序
+    include_archive: 同时查找 todo_archive，归档的结果排在 todo 的结果之后
+    due_before / due_after: 截止日期在 [due_after, due_before) 之间；指定后没有关键词时按截止日期升序
+    started: True 只要开始时间已到的任务，False 只要未设开始时间或还没开始的任务；now 默认取本地时间
+    tags: 只要同时带有这些标签的任务，从 todo_tag 的主键出发查找，不扫描 todo
+    时间条件都是索引上的范围扫描。
     """
-    where_clauses = []
+    filters = []
     params = []
-    
-    # 基础查询语句
-    sql = "SELECT task_id, content, is_done, created_at, deadline FROM todo"
+    join = ''
+    order_by = "todo.created_at DESC, todo.task_id DESC"
+    tags = normalize_tags(tags)
 
     if status is not None:
-        where_clauses.append("is_done = ?")
+        # 有标签条件时写成 +todo.is_done，不让它选中 (is_done, created_at) 索引去逐个检查未完成的任务，
+        # 而是从标签的主键找出任务再排序：带某个标签的任务通常只是一小部分
+        filters.append("+todo.is_done = ?" if tags else "todo.is_done = ?")
         params.append(status)
 
-    if text_search:
-        # 使用 LIKE 进行模糊查询
-        where_clauses.append("content LIKE ?")
+    if text_search and len(text_search) >= FTS_MIN_CHARS:
+        # 走 todo_fts 全文索引，按 bm25 相关度排序，相关度相同的再按创建时间
+        join = "JOIN todo_fts ON todo_fts.rowid = todo.task_id"
+        filters.append("todo_fts MATCH ?")
+        params.append(_fts_phrase(text_search))
+        order_by = "todo_fts.rank, todo.created_at DESC, todo.task_id DESC"
+    elif text_search:
+        # trigram 索引至少需要 3 个字符，更短的关键词只能退回 LIKE
+        filters.append("todo.content LIKE ?")
         # 参数需要我们手动加上 %
         params.append(f"%{text_search}%")
-    
-    if where_clauses:
-        sql += " WHERE " + " AND ".join(where_clauses)
-    
-    sql += " ORDER BY created_at DESC;"
-
-    with get_db() as conn:
-        cursor = conn.cursor()
-        cursor.execute(sql, tuple(params))
-        results = cursor.fetchall()
-        return [dict(row) for row in results]
-   
+
+    for name in tags:
+        filters.append("todo.task_id IN (SELECT task_id FROM todo_tag"
+                       " WHERE tag_id = (SELECT tag_id FROM tag WHERE name = ?))")
+        params.append(name)
+
+    time_filters, time_params = _time_filters('todo', due_before, due_after, started, now)
+    filters.extend(time_filters)
+    params.extend(time_params)
+    if (due_after is not None or due_before is not None) and not text_search:
+        # 与截止日期索引的顺序一致，范围扫描的结果不需要再排序
+        order_by = "todo.deadline, todo.task_id"
+
+    sql = query.select('todo', TASK_COLUMNS, tuple(filters), join, order_by)
+
+    conn = get_db()
+    cursor = _task_cursor(conn)
+    cursor.execute(sql, tuple(params))
+    results = cursor.fetchall()
+
+    # 归档里只有已完成的任务；归档时标签也一并去掉了
+    if include_archive and status != 0 and not tags:
+        results.extend(_find_archived(text_search, due_before, due_after, started, now))
+    return results
+
+def _time_filters(table, due_before, due_after, started, now):
+    """find_todos 的时间条件，返回 (SQL 片段列表, 参数列表)"""
+    filters = []
+    params = []
+    if due_after is not None:
+        filters.append(f"{table}.deadline >= ?")
+        params.append(normalize_timestamp(due_after))
+    if due_before is not None:
+        filters.append(f"{table}.deadline < ?")
+        params.append(normalize_timestamp(due_before))
+    if started is not None:
+        if now is None:
+            from datetime import datetime
+            now = datetime.now()
+        if started:
+            filters.append(f"{table}.start_at <= ?")
+        else:
+            filters.append(f"({table}.start_at IS NULL OR {table}.start_at > ?)")
+        params.append(normalize_timestamp(now))
+    return filters, params
+
+def _find_archived(text_search=None, due_before=None, due_after=None, started=None, now=None):
+    """在 todo_archive 中查找。归档是冷数据，没有全文索引，直接用 LIKE"""
+    filters, params = _time_filters('todo_archive', due_before, due_after, started, now)
+    if text_search:
+        filters.insert(0, "todo_archive.content LIKE ?")
+        params.insert(0, f"%{text_search}%")
+    sql = query.select('todo_archive', TASK_COLUMNS, tuple(filters),
+                       order_by="todo_archive.created_at DESC, todo_archive.task_id DESC")
+    conn = get_db()
+    cursor = _task_cursor(conn)
+    cursor.execute(sql, tuple(params))
+    return cursor.fetchall()
+
+def archive_done(older_than_days=None, batch_size=ARCHIVE_BATCH_SIZE, vacuum=True):
+    """
+    把完成超过 older_than_days 天的任务分批移到 todo_archive，返回移动的数量。
+    每批一个事务；全部移完后执行增量 vacuum，把空出来的页还给文件系统。
+    """
+    from datetime import datetime, timedelta, timezone
+    if older_than_days is None:
+        older_than_days = config.get_int('archive', 'after_days', ARCHIVE_AFTER_DAYS)
+    # created_at、done_at 由 CURRENT_TIMESTAMP 生成，是 UTC 时间
+    cutoff = (datetime.now(timezone.utc) - timedelta(days=older_than_days)).strftime(TIMESTAMP_FORMAT)
+
+    # 走 idx_todo_done_since（迁移 0010），条件中的表达式必须与索引一致。没有统计信息时规划器会选
+    # idx_todo_is_done_deadline，每批都要把最近完成、不满足条件的任务重新扫一遍，所以用 INDEXED BY 固定下来
+    select_sql = ("SELECT task_id FROM todo INDEXED BY idx_todo_done_since"
+                  " WHERE is_done = 1 AND COALESCE(done_at, created_at) < ? LIMIT ?;")
+    copy_sql = ("INSERT INTO todo_archive (task_id, content, is_done, created_at, start_at, deadline, done_at)"
+                " SELECT task_id, content, is_done, created_at, start_at, deadline, done_at"
+                " FROM todo WHERE task_id = ?;")
+    delete_sql = "DELETE FROM todo WHERE task_id = ?;"
+
+    moved = 0
+    while True:
+        with transaction() as conn:
+            ids = [(task_id,) for (task_id,) in conn.execute(select_sql, (cutoff, batch_size)).fetchall()]
+            if ids:
+                conn.executemany(copy_sql, ids)
+                conn.executemany(delete_sql, ids)
+        if not ids:
+            break
+        moved += len(ids)
+        _notify('remove', [task_id for (task_id,) in ids])
+
+    if moved and vacuum:
+        reclaim_space()
+    _report(f"已归档 {moved} 个任务。")
+    return moved
+
+def reclaim_space():
+    """
+    把空闲页还给文件系统。已开启增量 vacuum 的数据库只做 incremental_vacuum；
+    旧数据库第一次调用时会切换到增量模式，这需要一次完整的 VACUUM。
+    """
+    conn = get_db()
+    if conn.execute("PRAGMA auto_vacuum;").fetchone()[0] != 2:
+        conn.execute("PRAGMA auto_vacuum = INCREMENTAL;")
+        conn.execute("VACUUM;")
+    else:
+        conn.execute("PRAGMA incremental_vacuum;").fetchall()
+
+def _database_bytes(conn):
+    """返回 (数据库大小, 其中空闲页的大小)，单位字节，按页数 × 页大小计算（含 WAL 中尚未写回的页）"""
+    page_size = conn.execute("PRAGMA page_size;").fetchone()[0]
+    page_count = conn.execute("PRAGMA page_count;").fetchone()[0]
+    freelist = conn.execute("PRAGMA freelist_count;").fetchone()[0]
+    return page_count * page_size, freelist * page_size
+
+def backup(dest, pages=None, progress=None):
+    """
+    在线备份整个数据库到文件 dest，返回备份的字节数。
+    每步复制 pages 页后释放读锁休息一下，备份期间其他连接和进程照常读写；
+    别的连接在备份中途提交时，SQLite 会从头重新复制，最终得到的总是某一时刻完整一致的数据库。
+    progress(剩余页数, 总页数) 在每一步之后调用。
+    """
+    if pages is None:
+        pages = config.get_int('backup', 'pages', BACKUP_PAGES)
+    conn = get_db()
+    # 备份只复制主数据库文件里的页，先把 WAL 写回，备份就不必额外读 WAL
+    checkpoint('PASSIVE')
+    _backup_to(conn, dest, pages=pages, progress=progress, sleep=BACKUP_SLEEP)
+    size = os.path.getsize(dest)
+    _report(f"已备份到 {dest}（{size} 字节）。")
+    return size
+
+def compact(into=None, full=False, analyze=True):
+    """
+    整理数据库：回收空闲页（见 reclaim_space），并用 ANALYZE 更新查询规划器的统计信息。
+    incremental_vacuum 只能归还整页空闲的页；大量删除后留下的半空页要 full=True 完整 VACUUM 重建，
+    重建期间数据库被独占锁住。into 指定文件时不改动当前数据库，而是用 VACUUM INTO 写出一份重建过的副本。
+    返回 {'before': 整理前字节数, 'after': 整理后字节数, 'reclaimed': 回收的字节数, 'analyzed': 是否做了 ANALYZE}
+    """
+    conn = get_db()
+    before, _ = _database_bytes(conn)
+    if analyze:
+        # 先统计再整理，VACUUM INTO 的副本也带上 sqlite_stat1
+        conn.execute("ANALYZE;")
+        conn.commit()
+    if into is not None:
+        if os.path.exists(into):
+            raise ValueError(f"{into} 已存在，VACUUM INTO 不会覆盖已有文件")
+        conn.execute("VACUUM INTO ?;", (into,))
+        after = os.path.getsize(into)
+    else:
+        if full:
+            conn.execute("VACUUM;")
+        else:
+            reclaim_space()
+        # 空闲页回收后，WAL 写回主文件并截断，文件大小才真正变小
+        checkpoint('TRUNCATE')
+        after, _ = _database_bytes(conn)
+    result = {'before': before, 'after': after, 'reclaimed': max(before - after, 0), 'analyzed': analyze}
+    _report(f"整理完成：{before} → {after} 字节，回收 {result['reclaimed']} 字节。")
+    return result
@@ -0,0 +1,297 @@
+# todo/instrument.py
+# SQL 语句级别的统计：每条语句的耗时直方图、返回/影响行数、连接打开次数，以及慢查询日志
+#
+# 默认关闭，不影响正常命令的速度。开启方式：
+#   TODO_STATS=1 todo list ...     进程退出时把统计摘要打印到标准错误
+#   todo serve                     守护进程始终开启，用 `todo stats` 查看
+#   todo --profile trace.json      每条语句同时记成一个剖析事件，见 tracing.py
+# 慢查询阈值由 [stats] slow_ms 配置（默认 100 毫秒），超过阈值的语句连同 EXPLAIN QUERY PLAN
+# 一起写到 [stats] slow_log 指定的文件，没有配置时写到标准错误。
+
+import atexit
+import os
+import sqlite3
+import sys
+import threading
+import time
+
+from . import config
+from . import tracing
+
+DEFAULT_SLOW_MS = 100
+# 摘要里最多列出的语句数量（按总耗时排序）
+SUMMARY_LIMIT = 20
+# 剖析（tracing）时 sql 事件名最多保留语句的前这么多个字符，完整语句放在事件详情里
+TRACE_NAME_CHARS = 80
+
+ENABLED = False
+_lock = threading.Lock()
+_statements = {}
+_connections_opened = 0
+_slow_ms = DEFAULT_SLOW_MS
+# 写锁（BEGIN IMMEDIATE）的等待情况；重试和失败次数在关闭统计时也会记录
+_lock_retries = 0
+_lock_failures = 0
+# 结果还没取完、尚未记录的游标（weakref.WeakSet，enable() 时创建），生成摘要前先把它们记录下来
+_pending_cursors = None
+
+
+class _StatementStats:
+    """一条语句文本的累计数据；直方图按微秒取 2 的幂分桶"""
+    __slots__ = ('calls', 'total', 'rows', 'buckets')
+
+    def __init__(self):
+        self.calls = 0
+        self.total = 0.0
+        self.rows = 0
+        self.buckets = {}
+
+    def percentile(self, fraction):
+        """由直方图估算分位数，返回所在桶的上界（毫秒）"""
+        target = self.calls * fraction
+        seen = 0
+        for bucket in sorted(self.buckets):
+            seen += self.buckets[bucket]
+            if seen >= target:
+                return (1 << bucket) / 1000
+        return 0.0
+
+
+def _record(conn, sql, params, elapsed, rows):
+    """记录一次语句执行；elapsed 单位为秒"""
+    key = ' '.join(sql.split())
+    bucket = int(elapsed * 1_000_000).bit_length()
+    with _lock:
+        stats = _statements.get(key)
+        if stats is None:
+            stats = _statements[key] = _StatementStats()
+        stats.calls += 1
+        stats.total += elapsed
+        stats.rows += max(rows, 0)
+        stats.buckets[bucket] = stats.buckets.get(bucket, 0) + 1
+    if elapsed * 1000 >= _slow_ms:
+        _log_slow(conn, key, sql, params, elapsed)
+    if tracing.ENABLED:
+        # 以语句文本命名，火焰图里同一条语句合并在一起
+        tracing.record(key[:TRACE_NAME_CHARS], 'sql', time.perf_counter() - elapsed, elapsed,
+                       {'sql': key, 'rows': rows})
+
+def _log_slow(conn, key, sql, params, elapsed):
+    """写一条慢查询日志，附上查询计划"""
+    try:
+        plan = [row[3] for row in sqlite3.Cursor(conn).execute("EXPLAIN QUERY PLAN " + sql, params)]
+    except sqlite3.Error as e:
+        plan = [f"(无法获取查询计划: {e})"]
+    lines = [f"[慢查询] {elapsed * 1000:.1f} ms: {key}"]
+    lines.extend(f"    {step}" for step in plan)
+    text = '\n'.join(lines) + '\n'
+    path = config.get('stats', 'slow_log')
+    if path:
+        with open(path, 'a', encoding='utf-8') as f:
+            f.write(text)
+    else:
+        sys.stderr.write(text)
+
+
+class InstrumentedCursor(sqlite3.Cursor):
+    """
+    记录耗时的游标。SELECT（以及 RETURNING）语句的耗时要算到第一次取结果为止，
+    因为 SQLite 是在取结果时才真正执行查询；其他语句在 execute 返回时就记录。
+    fetchone / fetchall 取一次就记录；fetchmany 和直接遍历游标会累计行数，
+    直到结果取完、游标关闭或被回收、执行下一条语句，或者生成统计摘要时才记录。
+    """
+
+    # [sql, params, 开始时间, 第一次取结果时的耗时（还没取过时为 None）, 累计行数]
+    _pending = None
+
+    def execute(self, sql, params=()):
+        self._finish()
+        start = time.perf_counter()
+        super().execute(sql, params)
+        if self.description is None:
+            _record(self.connection, sql, params, time.perf_counter() - start, self.rowcount)
+        else:
+            self._pending = [sql, params, start, None, 0]
+            _pending_cursors.add(self)
+        return self
+
+    def executemany(self, sql, seq_of_params):
+        self._finish()
+        start = time.perf_counter()
+        super().executemany(sql, seq_of_params)
+        _record(self.connection, sql, (), time.perf_counter() - start, self.rowcount)
+        return self
+
+    def _fetched(self, rows, done):
+        """取到了 rows 行结果；done 为 True 表示这条语句不会再取结果，可以记录了"""
+        pending = self._pending
+        if pending is None:
+            return
+        if pending[3] is None:
+            pending[3] = time.perf_counter() - pending[2]
+        pending[4] += rows
+        if done:
+            self._finish()
+
+    def _finish(self):
+        """记录尚未记录的语句；一次都没取过结果时耗时算到现在"""
+        with _lock:
+            pending = self._pending
+            self._pending = None
+        if pending is None:
+            return
+        _pending_cursors.discard(self)
+        sql, params, start, elapsed, rows = pending
+        if elapsed is None:
+            elapsed = time.perf_counter() - start
+        _record(self.connection, sql, params, elapsed, rows)
+
+    def fetchone(self):
+        row = super().fetchone()
+        self._fetched(0 if row is None else 1, True)
+        return row
+
+    def fetchmany(self, size=None):
+        size = self.arraysize if size is None else size
+        rows = super().fetchmany(size)
+        self._fetched(len(rows), len(rows) < size)
+        return rows
+
+    def fetchall(self):
+        rows = super().fetchall()
+        self._fetched(len(rows), True)
+        return rows
+
+    def __next__(self):
+        try:
+            row = super().__next__()
+        except StopIteration:
+            self._fetched(0, True)
+            raise
+        self._fetched(1, False)
+        return row
+
+    def close(self):
+        self._finish()
+        super().close()
+
+    def __del__(self):
+        try:
+            self._finish()
+        except Exception:
+            # 解释器退出时模块可能已经被清理
+            pass
+
+
+class InstrumentedConnection(sqlite3.Connection):
+    """默认创建 InstrumentedCursor 的连接"""
+
+    def cursor(self, factory=InstrumentedCursor):
+        return super().cursor(factory)
+
+    def execute(self, sql, params=()):
+        return self.cursor().execute(sql, params)
+
+    def executemany(self, sql, seq_of_params):
+        return self.cursor().executemany(sql, seq_of_params)
+
+    def executescript(self, script):
+        start = time.perf_counter()
+        cursor = super().executescript(script)
+        _record(self, '-- executescript', (), time.perf_counter() - start, -1)
+        return cursor
+
+
+# 写锁等待时间的直方图，放在 _StatementStats 定义之后
+_lock_waits = _StatementStats()
+
+
+def record_lock_wait(elapsed, retries, failed=False):
+    """db._begin_write 每次开始写事务时调用；elapsed 单位为秒"""
+    global _lock_retries, _lock_failures
+    if not (ENABLED or retries or failed):
+        return
+    with _lock:
+        _lock_retries += retries
+        _lock_failures += failed
+        if ENABLED and not failed:
+            _lock_waits.calls += 1
+            _lock_waits.total += elapsed
+            bucket = int(elapsed * 1_000_000).bit_length()
+            _lock_waits.buckets[bucket] = _lock_waits.buckets.get(bucket, 0) + 1
+
+def connection_factory():
+    """开启统计时 db 打开连接用的工厂类，关闭时返回 None"""
+    return InstrumentedConnection if ENABLED else None
+
+def record_connect():
+    global _connections_opened
+    with _lock:
+        _connections_opened += 1
+
+def enable(dump_at_exit=False):
+    """开启统计；要在打开数据库连接之前调用才能覆盖所有语句"""
+    global ENABLED, _slow_ms, _pending_cursors
+    _slow_ms = config.get_int('stats', 'slow_ms', DEFAULT_SLOW_MS)
+    if _pending_cursors is None:
+        import weakref
+        _pending_cursors = weakref.WeakSet()
+    if dump_at_exit and not ENABLED:
+        atexit.register(lambda: sys.stderr.write(format_summary(summary())))
+    ENABLED = True
+
+def reset():
+    global _connections_opened, _lock_retries, _lock_failures, _lock_waits
+    with _lock:
+        _statements.clear()
+        _connections_opened = 0
+        _lock_retries = _lock_failures = 0
+        _lock_waits = _StatementStats()
+
+def summary(limit=SUMMARY_LIMIT):
+    """返回可以序列化成 JSON 的统计摘要，语句按总耗时从高到低排列"""
+    for cursor in list(_pending_cursors or ()):
+        cursor._finish()
+    with _lock:
+        items = sorted(_statements.items(), key=lambda item: item[1].total, reverse=True)
+        statements = [{
+            'sql': sql,
+            'calls': stats.calls,
+            'total_ms': stats.total * 1000,
+            'mean_ms': stats.total * 1000 / stats.calls,
+            'p50_ms': stats.percentile(0.5),
+            'p95_ms': stats.percentile(0.95),
+            'rows': stats.rows,
+        } for sql, stats in items[:limit]]
+        return {
+            'enabled': ENABLED,
+            'connections_opened': _connections_opened,
+            'statements_executed': sum(stats.calls for stats in _statements.values()),
+            'write_lock': {
+                'acquired': _lock_waits.calls,
+                'wait_total_ms': _lock_waits.total * 1000,
+                'wait_p95_ms': _lock_waits.percentile(0.95),
+                'retries': _lock_retries,
+                'failures': _lock_failures,
+            },
+            'statements': statements,
+        }
+
+def format_summary(data):
+    """把 summary() 的结果排成一张文本表"""
+    lock = data['write_lock']
+    lines = [
+        f"连接打开次数: {data['connections_opened']}   语句执行次数: {data['statements_executed']}",
+        f"写锁: 获取 {lock['acquired']} 次, 等待共 {lock['wait_total_ms']:.2f} ms (p95 {lock['wait_p95_ms']:.3f} ms), "
+        f"重试 {lock['retries']} 次, 失败 {lock['failures']} 次",
+        f"{'calls':>7} {'total_ms':>10} {'mean_ms':>9} {'p95_ms':>9} {'rows':>8}  statement",
+    ]
+    for s in data['statements']:
+        sql = s['sql'] if len(s['sql']) <= 80 else s['sql'][:77] + '...'
+        lines.append(f"{s['calls']:>7} {s['total_ms']:>10.2f} {s['mean_ms']:>9.3f} "
+                     f"{s['p95_ms']:>9.3f} {s['rows']:>8}  {sql}")
+    return '\n'.join(lines) + '\n'
+
+
+if os.environ.get('TODO_STATS'):
+    enable(dump_at_exit=True)
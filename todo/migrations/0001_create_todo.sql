@@ -1,7 +1,6 @@
--- 在开发阶段，每次初始化都重建数据表，确保结构最新
-DROP TABLE IF EXISTS todo;
-
-CREATE TABLE todo (
+-- 版本 1：创建待办事项表
+-- 使用 IF NOT EXISTS，兼容旧版本（没有 user_version）留下的数据库
+CREATE TABLE IF NOT EXISTS todo (
     task_id INTEGER PRIMARY KEY AUTOINCREMENT,
     content TEXT NOT NULL,
     is_done INTEGER NOT NULL DEFAULT 0, -- 0 for false, 1 for true
@@ -0,0 +1,9 @@
+-- 版本 2：为常用查询建立二级索引
+-- get_all_todos: ORDER BY created_at DESC，按索引顺序读取，省去临时排序
+CREATE INDEX IF NOT EXISTS idx_todo_created_at ON todo (created_at DESC);
+
+-- find_todos(status=...): WHERE is_done = ? ORDER BY created_at DESC
+CREATE INDEX IF NOT EXISTS idx_todo_is_done_created_at ON todo (is_done, created_at DESC);
+
+-- 按截止日期的范围查询（到期提醒、逾期统计等）
+CREATE INDEX IF NOT EXISTS idx_todo_deadline ON todo (deadline);
@@ -0,0 +1,25 @@
+-- 版本 3：content 的全文索引
+-- 外部内容表，只存索引不重复存正文；trigram 分词对中文等没有空格的文本同样有效
+CREATE VIRTUAL TABLE IF NOT EXISTS todo_fts USING fts5(
+    content,
+    content='todo',
+    content_rowid='task_id',
+    tokenize='trigram'
+);
+
+-- 用触发器让全文索引与 todo 表保持同步
+CREATE TRIGGER IF NOT EXISTS todo_fts_ai AFTER INSERT ON todo BEGIN
+    INSERT INTO todo_fts (rowid, content) VALUES (new.task_id, new.content);
+END;
+
+CREATE TRIGGER IF NOT EXISTS todo_fts_ad AFTER DELETE ON todo BEGIN
+    INSERT INTO todo_fts (todo_fts, rowid, content) VALUES ('delete', old.task_id, old.content);
+END;
+
+CREATE TRIGGER IF NOT EXISTS todo_fts_au AFTER UPDATE OF content ON todo BEGIN
+    INSERT INTO todo_fts (todo_fts, rowid, content) VALUES ('delete', old.task_id, old.content);
+    INSERT INTO todo_fts (rowid, content) VALUES (new.task_id, new.content);
+END;
+
+-- 为升级前已有的数据建立索引
+INSERT INTO todo_fts (todo_fts) VALUES ('rebuild');
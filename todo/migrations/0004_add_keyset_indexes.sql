@@ -0,0 +1,7 @@
+-- 版本 4：分页需要稳定的排序键 (created_at, task_id)
+-- 把 task_id 显式放进索引，ORDER BY created_at DESC, task_id DESC 就能完全由索引提供
+DROP INDEX IF EXISTS idx_todo_created_at;
+DROP INDEX IF EXISTS idx_todo_is_done_created_at;
+
+CREATE INDEX IF NOT EXISTS idx_todo_created_at ON todo (created_at DESC, task_id DESC);
+CREATE INDEX IF NOT EXISTS idx_todo_is_done_created_at ON todo (is_done, created_at DESC, task_id DESC);
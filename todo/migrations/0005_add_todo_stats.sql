@@ -0,0 +1,29 @@
+-- 版本 5：按完成状态维护的任务计数，以及按完成状态分组的截止日期索引
+-- 计数由触发器维护，统计数量不再需要扫描 todo
+CREATE TABLE IF NOT EXISTS todo_stats (
+    is_done INTEGER PRIMARY KEY,
+    task_count INTEGER NOT NULL DEFAULT 0
+);
+
+DELETE FROM todo_stats;
+INSERT INTO todo_stats (is_done, task_count)
+    SELECT is_done, COUNT(*) FROM todo GROUP BY is_done;
+
+CREATE TRIGGER IF NOT EXISTS todo_stats_ai AFTER INSERT ON todo BEGIN
+    INSERT INTO todo_stats (is_done, task_count) VALUES (new.is_done, 1)
+        ON CONFLICT (is_done) DO UPDATE SET task_count = task_count + 1;
+END;
+
+CREATE TRIGGER IF NOT EXISTS todo_stats_ad AFTER DELETE ON todo BEGIN
+    UPDATE todo_stats SET task_count = task_count - 1 WHERE is_done = old.is_done;
+END;
+
+CREATE TRIGGER IF NOT EXISTS todo_stats_au AFTER UPDATE OF is_done ON todo
+WHEN old.is_done IS NOT new.is_done BEGIN
+    UPDATE todo_stats SET task_count = task_count - 1 WHERE is_done = old.is_done;
+    INSERT INTO todo_stats (is_done, task_count) VALUES (new.is_done, 1)
+        ON CONFLICT (is_done) DO UPDATE SET task_count = task_count + 1;
+END;
+
+-- 逾期、即将到期只统计未完成的任务：is_done = 0 AND deadline 范围，计数只读索引不回表
+CREATE INDEX IF NOT EXISTS idx_todo_is_done_deadline ON todo (is_done, deadline);
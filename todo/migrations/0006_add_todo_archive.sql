@@ -0,0 +1,23 @@
+-- 版本 6：归档表，完成已久的任务从 todo 移到这里，让 todo 及其索引保持精简
+-- done_at 记录任务被标记为完成的时间（UTC，与 created_at 一致），归档按它判断任务“完成了多久”
+ALTER TABLE todo ADD COLUMN done_at TIMESTAMP NULL;
+
+CREATE TRIGGER IF NOT EXISTS todo_done_at_au AFTER UPDATE OF is_done ON todo
+WHEN old.is_done IS NOT new.is_done BEGIN
+    UPDATE todo SET done_at = CASE WHEN new.is_done = 1 THEN CURRENT_TIMESTAMP END
+        WHERE task_id = new.task_id;
+END;
+
+-- task_id 沿用原来的值；todo 使用 AUTOINCREMENT，归档后的 ID 不会被新任务重复使用
+CREATE TABLE IF NOT EXISTS todo_archive (
+    task_id INTEGER PRIMARY KEY,
+    content TEXT NOT NULL,
+    is_done INTEGER NOT NULL DEFAULT 1,
+    created_at TIMESTAMP NOT NULL,
+    start_at TIMESTAMP NULL,
+    deadline TIMESTAMP NULL,
+    done_at TIMESTAMP NULL,
+    archived_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP
+);
+
+CREATE INDEX IF NOT EXISTS idx_todo_archive_created_at ON todo_archive (created_at DESC, task_id DESC);
@@ -0,0 +1,17 @@
+-- 版本 7：时间字段统一成 'YYYY-MM-DD HH:MM:SS'
+-- 写入时由 db.normalize_timestamp 保证格式；这里把升级前用户随手输入的值改写成同样的格式，
+-- 之后按字符串比较就是按时间比较，范围查询可以直接走索引。
+-- normalize_timestamp() 是 db._migrate 注册的 SQL 函数，规则与写入时完全相同（带时区的值换算成本地时间）；
+-- 它认不出来的值（'now'、'2026' 等）原样返回，不丢数据。不用 SQLite 的 datetime()：
+-- 它会把 'now' 换成迁移时的时间、把纯数字当成儒略日，还会把带时区的值换算成 UTC。
+UPDATE todo SET deadline = normalize_timestamp(deadline)
+    WHERE deadline IS NOT normalize_timestamp(deadline);
+UPDATE todo SET start_at = normalize_timestamp(start_at)
+    WHERE start_at IS NOT normalize_timestamp(start_at);
+UPDATE todo_archive SET deadline = normalize_timestamp(deadline)
+    WHERE deadline IS NOT normalize_timestamp(deadline);
+UPDATE todo_archive SET start_at = normalize_timestamp(start_at)
+    WHERE start_at IS NOT normalize_timestamp(start_at);
+
+-- find_todos(started=...): 按开始时间的范围查询
+CREATE INDEX IF NOT EXISTS idx_todo_start_at ON todo (start_at);
@@ -0,0 +1,32 @@
+-- 版本 8：变更日志，供 `todo sync` 在机器之间增量同步
+-- 只记录哪个任务在什么时候变过（seq 单调递增，AUTOINCREMENT 保证删除后也不会重复使用），
+-- 导出时再读取任务的最新内容：同一个任务改多少次，同步时都只传一次。
+CREATE TABLE IF NOT EXISTS todo_changes (
+    seq INTEGER PRIMARY KEY AUTOINCREMENT,
+    task_id INTEGER NOT NULL,
+    changed_at TIMESTAMP NOT NULL DEFAULT CURRENT_TIMESTAMP
+);
+
+CREATE TRIGGER IF NOT EXISTS todo_changes_ai AFTER INSERT ON todo BEGIN
+    INSERT INTO todo_changes (task_id) VALUES (new.task_id);
+END;
+
+-- done_at 只会随 is_done 一起变化，不单独记录
+CREATE TRIGGER IF NOT EXISTS todo_changes_au AFTER UPDATE OF content, is_done, start_at, deadline ON todo BEGIN
+    INSERT INTO todo_changes (task_id) VALUES (new.task_id);
+END;
+
+CREATE TRIGGER IF NOT EXISTS todo_changes_ad AFTER DELETE ON todo BEGIN
+    INSERT INTO todo_changes (task_id) VALUES (old.task_id);
+END;
+
+-- 同步写入的任务带着对方的 done_at，这时不能改成本地的当前时间
+DROP TRIGGER IF EXISTS todo_done_at_au;
+CREATE TRIGGER todo_done_at_au AFTER UPDATE OF is_done ON todo
+WHEN old.is_done IS NOT new.is_done AND new.done_at IS old.done_at BEGIN
+    UPDATE todo SET done_at = CASE WHEN new.is_done = 1 THEN CURRENT_TIMESTAMP END
+        WHERE task_id = new.task_id;
+END;
+
+-- 升级前已有的任务都算作一次变更，`todo sync --since 0` 就是完整的一份
+INSERT INTO todo_changes (task_id) SELECT task_id FROM todo ORDER BY task_id;
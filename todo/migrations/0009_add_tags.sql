@@ -0,0 +1,41 @@
+-- 版本 9：标签。tag 保存标签名和按标签统计的任务数量，todo_tag 是任务与标签的多对多关系
+-- 标签名不区分大小写，保存第一次使用时的写法
+CREATE TABLE IF NOT EXISTS tag (
+    tag_id INTEGER PRIMARY KEY,
+    name TEXT NOT NULL UNIQUE COLLATE NOCASE,
+    task_count INTEGER NOT NULL DEFAULT 0,
+    open_count INTEGER NOT NULL DEFAULT 0
+);
+
+-- 主键 (tag_id, task_id) 用于“某个标签下的任务”，idx_todo_tag_task_id 用于“某个任务的标签”
+CREATE TABLE IF NOT EXISTS todo_tag (
+    tag_id INTEGER NOT NULL,
+    task_id INTEGER NOT NULL,
+    PRIMARY KEY (tag_id, task_id)
+) WITHOUT ROWID;
+
+CREATE INDEX IF NOT EXISTS idx_todo_tag_task_id ON todo_tag (task_id, tag_id);
+
+-- 计数由触发器维护，与 todo_stats 一样不需要扫描
+CREATE TRIGGER IF NOT EXISTS todo_tag_ai AFTER INSERT ON todo_tag BEGIN
+    UPDATE tag SET task_count = task_count + 1,
+                   open_count = open_count + COALESCE((SELECT is_done = 0 FROM todo WHERE task_id = new.task_id), 0)
+        WHERE tag_id = new.tag_id;
+END;
+
+CREATE TRIGGER IF NOT EXISTS todo_tag_ad AFTER DELETE ON todo_tag BEGIN
+    UPDATE tag SET task_count = task_count - 1,
+                   open_count = open_count - COALESCE((SELECT is_done = 0 FROM todo WHERE task_id = old.task_id), 0)
+        WHERE tag_id = old.tag_id;
+END;
+
+-- 删除（包括归档）任务时一并去掉它的标签；用 BEFORE，todo_tag_ad 还能读到任务的完成状态
+CREATE TRIGGER IF NOT EXISTS todo_tag_todo_bd BEFORE DELETE ON todo BEGIN
+    DELETE FROM todo_tag WHERE task_id = old.task_id;
+END;
+
+CREATE TRIGGER IF NOT EXISTS todo_tag_todo_au AFTER UPDATE OF is_done ON todo
+WHEN old.is_done IS NOT new.is_done BEGIN
+    UPDATE tag SET open_count = open_count + CASE WHEN new.is_done = 0 THEN 1 ELSE -1 END
+        WHERE tag_id IN (SELECT tag_id FROM todo_tag WHERE task_id = new.task_id);
+END;
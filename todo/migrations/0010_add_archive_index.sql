@@ -0,0 +1,4 @@
+-- 版本 10：archive_done 按“完成了多久”挑选任务，条件是 is_done = 1 AND COALESCE(done_at, created_at) < ?
+-- 部分索引只包含已完成的任务，按同一个表达式排序，每批直接从最早完成的任务读起，
+-- 不必把最近完成、还不满足条件的任务一批批重新扫一遍。表达式必须与 db.archive_done 中的完全一致
+CREATE INDEX IF NOT EXISTS idx_todo_done_since ON todo (COALESCE(done_at, created_at)) WHERE is_done = 1;
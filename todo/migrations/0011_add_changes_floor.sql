@@ -0,0 +1,8 @@
+-- 版本 11：记录变更日志清理到了哪个序号。todo sync --prune 删掉的变更再也导不出来，
+-- 导出时 since 小于这个序号就说明对方缺了一段，只能重新做一次完整导出。只有一行
+CREATE TABLE IF NOT EXISTS todo_changes_floor (
+    id INTEGER PRIMARY KEY CHECK (id = 1),
+    seq INTEGER NOT NULL
+);
+
+INSERT OR IGNORE INTO todo_changes_floor (id, seq) VALUES (1, 0);
@@ -0,0 +1,46 @@
+# todo/query.py
+# SQL 语句构造。每种“表 + 列 + 条件 + 排序”的组合只拼接一次，之后直接返回同一个字符串：
+# 调用方不用每次都拼字符串，同一种组合也总是得到完全相同的语句文本，
+# sqlite3 的语句缓存（按文本匹配，见 db.STATEMENT_CACHE_SIZE）可以复用编译好的语句。
+#
+# 条件是带 ? 占位符的 SQL 片段，参数由调用方按同样的顺序收集，例如：
+#     filters, params = [], []
+#     if status is not None:
+#         filters.append("todo.is_done = ?")
+#         params.append(status)
+#     sql = query.select('todo', TASK_COLUMNS, tuple(filters), order_by="todo.created_at DESC")
+# 片段必须是代码里的常量，不能包含用户输入，否则每个不同的值都会变成一种新组合。
+
+from functools import lru_cache
+
+# 缓存的组合数量上限，与 db.STATEMENT_CACHE_SIZE 一致；组合数由代码决定，正常远达不到
+CACHE_SIZE = 128
+
+
+@lru_cache(maxsize=CACHE_SIZE)
+def select(table, columns, filters=(), join='', order_by='', limit=False):
+    """
+    SELECT 语句。columns 会加上表名前缀，这样与 join 进来的表同名的列也不会有歧义。
+    filters 用 AND 连接；limit 为 True 时在末尾加 LIMIT ?，参数放在最后。
+    """
+    sql = f"SELECT {', '.join(f'{table}.{c}' for c in columns)} FROM {table}"
+    if join:
+        sql += f" {join}"
+    if filters:
+        sql += " WHERE " + " AND ".join(filters)
+    if order_by:
+        sql += f" ORDER BY {order_by}"
+    if limit:
+        sql += " LIMIT ?"
+    return sql + ";"
+
+@lru_cache(maxsize=CACHE_SIZE)
+def update(table, fields, key='task_id', returning=()):
+    """
+    按主键更新 fields 中的列：UPDATE table SET a = ?, b = ? WHERE key = ? [RETURNING ...]。
+    参数顺序是 fields 的值，最后是主键。
+    """
+    sql = f"UPDATE {table} SET {', '.join(f'{f} = ?' for f in fields)} WHERE {key} = ?"
+    if returning:
+        sql += f" RETURNING {', '.join(returning)}"
+    return sql + ";"
@@ -0,0 +1,125 @@
+# todo/render.py
+# 任务列表的输出：按显示宽度对齐/截断中文，终端里分页，管道里分块流式写出
+
+import shutil
+import sys
+import unicodedata
+
+# 输出不是终端时，每累积这么多行写一次
+CHUNK_LINES = 512
+# 截断内容时使用的省略号，只用 ASCII，避免在不同终端里宽度不一致
+ELLIPSIS = '...'
+
+
+def char_width(ch):
+    """一个字符在终端里占的列数：中日韩全角字符为 2，组合字符为 0"""
+    if unicodedata.combining(ch):
+        return 0
+    return 2 if unicodedata.east_asian_width(ch) in ('W', 'F') else 1
+
+def display_width(text):
+    """字符串在终端里占的列数"""
+    if text.isascii():
+        return len(text)
+    return sum(map(char_width, text))
+
+def truncate(text, width):
+    """按显示宽度截断 text，超出时末尾用省略号表示"""
+    if display_width(text) <= width:
+        return text
+    limit = width - len(ELLIPSIS)
+    if limit <= 0:
+        return ELLIPSIS[:max(width, 0)]
+    if text.isascii():
+        return text[:limit] + ELLIPSIS
+    kept = []
+    used = 0
+    for ch in text:
+        w = char_width(ch)
+        if used + w > limit:
+            break
+        kept.append(ch)
+        used += w
+    return ''.join(kept) + ELLIPSIS
+
+def format_task(task, width=None):
+    """
+    把一个任务格式化成一行文本。
+    width: 给定时按终端宽度截断任务内容，保证一行不会折行
+    """
+    # 根据 is_done 状态显示不同的标记
+    status_icon = "[x]" if task.is_done else "[ ]"
+    prefix = f"{status_icon} ID: {task.task_id:<3} | "
+
+    # 如果有截止日期，就格式化显示
+    deadline_str = f" (截止日期: {task.deadline})" if task.deadline else ""
+
+    content = task.content
+    if width is not None:
+        room = width - display_width(prefix) - display_width(deadline_str)
+        content = truncate(content, max(room, len(ELLIPSIS)))
+    return f"{prefix}{content}{deadline_str}"
+
+def _ask_more():
+    """分页提示，返回 False 表示用户不想继续看"""
+    try:
+        answer = input("-- 回车显示下一页，输入 q 结束 -- ")
+    except EOFError:
+        return False
+    return answer.strip().lower() != 'q'
+
+def _stream(tasks, out):
+    """非终端输出：不截断、不分页，按块写出"""
+    count = 0
+    buffer = []
+    for task in tasks:
+        buffer.append(format_task(task))
+        count += 1
+        if len(buffer) >= CHUNK_LINES:
+            buffer.append('')
+            out.write('\n'.join(buffer))
+            buffer = []
+    if buffer:
+        buffer.append('')
+        out.write('\n'.join(buffer))
+    return count
+
+def _paginate(tasks, out, reserved_lines):
+    """终端输出：按终端宽度截断，每满一屏暂停一次"""
+    size = shutil.get_terminal_size()
+    page_lines = max(size.lines - reserved_lines - 1, 1)
+    count = 0
+    buffer = []
+    more_pending = False
+    for task in tasks:
+        # 确认后面确实还有任务，才提示翻页
+        if more_pending:
+            if not _ask_more():
+                return count
+            more_pending = False
+        buffer.append(format_task(task, size.columns))
+        count += 1
+        if len(buffer) >= page_lines:
+            buffer.append('')
+            out.write('\n'.join(buffer))
+            out.flush()
+            buffer = []
+            more_pending = True
+    if buffer:
+        buffer.append('')
+        out.write('\n'.join(buffer))
+    return count
+
+def render_tasks(tasks, out=None, reserved_lines=0):
+    """
+    输出任务列表，tasks 可以是列表也可以是 db.iter_todos 这样的迭代器。
+    reserved_lines: 每页要给表头、菜单等其他内容预留的行数
+    返回输出的任务数量
+    """
+    out = out or sys.stdout
+    if out.isatty():
+        count = _paginate(tasks, out, reserved_lines)
+    else:
+        count = _stream(tasks, out)
+    out.flush()
+    return count
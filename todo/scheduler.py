@@ -0,0 +1,194 @@
+# todo/scheduler.py
+# 截止日期提醒：用最小堆保存待触发的截止时间，睡到最近的一个到期为止
+
+import heapq
+import threading
+import time
+from datetime import datetime
+
+from . import config
+from . import db
+
+# 每隔多少秒检查一次 PRAGMA data_version，发现其他进程改过数据就重新加载，可用 [scheduler] poll_interval 覆盖。
+# 这条查询只读一个计数器，很便宜；它同时也是最长睡眠时间
+POLL_INTERVAL = 2
+# 堆中失效条目超过有效条目的这个倍数时重建堆
+_COMPACT_RATIO = 2
+
+
+def parse_deadline(text):
+    """
+    把 deadline 字符串解析成本地时间的时间戳，格式不对时返回 None。
+    写入时已经用 db.normalize_timestamp 统一成 db.TIMESTAMP_FORMAT，这里只认这一种格式。
+    """
+    try:
+        return datetime.strptime(text, db.TIMESTAMP_FORMAT).timestamp()
+    except ValueError:
+        return None
+
+def print_reminder(task):
+    """默认的提醒方式：直接打印到标准输出"""
+    print(f"[提醒] 任务 {task.task_id} 截止时间到了：{task.content} (截止日期: {task.deadline})", flush=True)
+
+
+class Scheduler:
+    """
+    截止日期调度器。
+    堆里保存 (触发时间, task_id)；_scheduled 记录每个任务当前有效的条目，
+    任务被修改或删除时只更新 _scheduled，堆里的旧条目在弹出时丢弃。
+    _fired 记录已经提醒过的 (task_id, deadline)：在提前量之内重新加载时，
+    触发时间已过的任务不会被再提醒一次；截止日期改了就是新的提醒。
+    作为 db 的观察者注册后，本进程内的增删改会增量更新堆，不需要重新查询。
+    todo remind 是独立进程，任务都是别的进程写入的，只能靠每 POLL_INTERVAL 秒检查 data_version 发现；
+    重新加载时从上一次加载的时间点查起，这期间新增、并且已经到期的任务也会（稍晚一点）提醒。
+    """
+
+    def __init__(self, on_due=print_reminder, lead_time=None):
+        self.on_due = on_due
+        # 提前多少秒提醒
+        if lead_time is None:
+            lead_time = config.get_int('scheduler', 'lead_time', 0)
+        self.lead_time = lead_time
+        self._heap = []
+        self._scheduled = {}
+        self._fired = set()
+        self._cond = threading.Condition()
+        self._reload_needed = True
+        self._data_version = None
+        self.poll_interval = config.get_int('scheduler', 'poll_interval', POLL_INTERVAL)
+        self._last_scan = time.monotonic()
+        # 上一次加载时的时间戳；第一次加载时为 None，只安排尚未到期的任务
+        self._loaded_at = None
+        self._stopped = False
+
+    # ---- db 观察者接口 ----
+
+    def put(self, task):
+        with self._cond:
+            self._schedule(task)
+            self._cond.notify()
+
+    def update(self, task_ids, **changes):
+        with self._cond:
+            if changes.get('is_done') == 1:
+                for task_id in task_ids:
+                    self._scheduled.pop(task_id, None)
+            else:
+                # 重新打开的任务可能带着截止日期，这里拿不到，交给下一轮重新加载
+                self._reload_needed = True
+            self._cond.notify()
+
+    def remove(self, task_ids):
+        with self._cond:
+            for task_id in task_ids:
+                self._scheduled.pop(task_id, None)
+            self._cond.notify()
+
+    def invalidate(self):
+        with self._cond:
+            self._reload_needed = True
+            self._cond.notify()
+
+    # ---- 调度 ----
+
+    def _schedule(self, task, not_before=None):
+        """
+        按任务最新状态安排（或取消）提醒，调用方持有锁。
+        截止时间早于 not_before（默认为现在）的任务不再提醒。
+        """
+        self._scheduled.pop(task.task_id, None)
+        if task.is_done or not task.deadline:
+            return
+        due = parse_deadline(task.deadline)
+        if due is None:
+            return
+        if due <= (time.time() if not_before is None else not_before):
+            # 已经过了截止时间的任务不补发提醒
+            return
+        if (task.task_id, task.deadline) in self._fired:
+            return
+        fire_at = due - self.lead_time
+        self._scheduled[task.task_id] = (fire_at, task)
+        heapq.heappush(self._heap, (fire_at, task.task_id))
+        if len(self._heap) > _COMPACT_RATIO * len(self._scheduled) + 16:
+            self._compact()
+
+    def _compact(self):
+        """丢掉堆里所有失效的条目"""
+        self._heap = [(fire_at, task_id) for task_id, (fire_at, _) in self._scheduled.items()]
+        heapq.heapify(self._heap)
+
+    def _load(self):
+        """用一次范围查询加载上一次加载以来尚未到期的截止日期"""
+        now = time.time()
+        since = now if self._loaded_at is None else min(self._loaded_at, now)
+        self._loaded_at = now
+        self._heap = []
+        self._scheduled = {}
+        tasks = db.get_upcoming_deadlines(datetime.fromtimestamp(since).strftime(db.TIMESTAMP_FORMAT))
+        # 截止时间已过或已被删除、完成的任务不会再出现，对应的记录可以丢掉
+        self._fired &= {(task.task_id, task.deadline) for task in tasks}
+        for task in tasks:
+            self._schedule(task, not_before=since)
+        self._data_version = self._current_data_version()
+        self._last_scan = time.monotonic()
+        self._reload_needed = False
+
+    def _current_data_version(self):
+        return db.get_db().execute("PRAGMA data_version;").fetchone()[0]
+
+    def _pop_due(self, now):
+        """弹出所有已经到时间的有效条目"""
+        due = []
+        while self._heap and self._heap[0][0] <= now:
+            fire_at, task_id = heapq.heappop(self._heap)
+            entry = self._scheduled.get(task_id)
+            if entry is not None and entry[0] == fire_at:
+                del self._scheduled[task_id]
+                self._fired.add((task_id, entry[1].deadline))
+                due.append(entry[1])
+        return due
+
+    def _wait_for_due(self):
+        """阻塞直到有提醒需要触发，期间不占用 CPU"""
+        with self._cond:
+            while not self._stopped:
+                if time.monotonic() - self._last_scan >= self.poll_interval:
+                    self._last_scan = time.monotonic()
+                    if self._current_data_version() != self._data_version:
+                        self._reload_needed = True
+                if self._reload_needed:
+                    self._load()
+
+                now = time.time()
+                due = self._pop_due(now)
+                if due:
+                    return due
+
+                timeout = self.poll_interval
+                if self._heap:
+                    timeout = min(max(self._heap[0][0] - now, 0), timeout)
+                self._cond.wait(timeout)
+            return []
+
+    def run(self):
+        """在当前线程中一直运行，直到 stop() 被调用"""
+        db.add_observer(self)
+        try:
+            while not self._stopped:
+                for task in self._wait_for_due():
+                    self.on_due(task)
+        finally:
+            db.remove_observer(self)
+
+    def stop(self):
+        with self._cond:
+            self._stopped = True
+            self._cond.notify()
+
+    def next_due(self):
+        """返回下一个将要触发的 (时间戳, Task)，没有时返回 None"""
+        with self._cond:
+            if not self._scheduled:
+                return None
+            return min(self._scheduled.values(), key=lambda entry: entry[0])
@@ -0,0 +1,99 @@
+# todo/server.py
+# todo serve：常驻进程，持有预热好的数据库连接，通过 Unix 套接字为命令行提供服务
+# 协议说明见 client.py
+
+import json
+import os
+import signal
+import socketserver
+
+from . import client
+from . import db
+from . import instrument
+
+# 允许远程调用的 db 函数，参数与 db 中同名函数一致
+OPERATIONS = {
+    'add_todo': db.add_todo,
+    'count_todos': db.count_todos,
+    'summary': db.summary,
+    'get_todos_page': db.get_todos_page,
+    'find_todos': db.find_todos,
+    'update_todo_status': db.update_todo_status,
+    'edit_todo': db.edit_todo,
+    'delete_todo': db.delete_todo,
+    'set_status_many': db.set_status_many,
+    'delete_many': db.delete_many,
+    'tag_todos': db.tag_todos,
+    'untag_todos': db.untag_todos,
+    'tag_counts': db.tag_counts,
+    'stats': instrument.summary,
+    'reset_stats': instrument.reset,
+}
+
+
+def handle_request(line):
+    """处理一行请求，返回一行响应（都不含换行符）"""
+    try:
+        request = json.loads(line)
+        func = OPERATIONS.get(request.get('op'))
+        if func is None:
+            raise ValueError(f"未知的操作 {request.get('op')!r}")
+        response = client.encode(func(**request.get('args', {})))
+    except Exception as e:
+        response = {'ok': False, 'error': f"{type(e).__name__}: {e}"}
+    return json.dumps(response, ensure_ascii=False)
+
+
+class _Handler(socketserver.StreamRequestHandler):
+    """一个客户端连接，可以连续发送多条请求"""
+
+    def handle(self):
+        try:
+            for raw in self.rfile:
+                line = raw.decode('utf-8').strip()
+                if not line:
+                    continue
+                self.wfile.write(handle_request(line).encode('utf-8') + b'\n')
+                self.wfile.flush()
+        finally:
+            # 处理线程结束前把连接还回池里，下一个客户端可以直接复用
+            db.release_db()
+
+
+def _raise_interrupt(signum, frame):
+    raise KeyboardInterrupt
+
+
+class _Server(socketserver.ThreadingMixIn, socketserver.UnixStreamServer):
+    daemon_threads = True
+
+
+def serve(path=None):
+    """在 path 上监听直到被中断；已有守护进程在运行时返回 False"""
+    path = path or client.default_socket_path()
+    existing = client.connect(path)
+    if existing is not None:
+        existing.close()
+        return False
+    if os.path.exists(path):
+        # 上一次异常退出留下的套接字文件
+        os.unlink(path)
+
+    db.QUIET = True
+    # 守护进程始终收集语句统计，供 `todo stats` 查询
+    instrument.enable()
+    db.init_db()
+    # 被 kill 时也要走到下面的清理逻辑，删除套接字文件
+    signal.signal(signal.SIGTERM, _raise_interrupt)
+    old_umask = os.umask(0o177)  # 套接字只允许当前用户访问
+    try:
+        server = _Server(path, _Handler)
+    finally:
+        os.umask(old_umask)
+    try:
+        server.serve_forever()
+    finally:
+        server.server_close()
+        if os.path.exists(path):
+            os.unlink(path)
+    return True
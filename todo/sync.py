@@ -0,0 +1,78 @@
+# todo/sync.py
+# 增量同步：把某个序号之后的变更导出成一个压缩文件，在另一台机器上应用
+#
+#   todo sync --since 0 -o full.sync.gz         # 第一次：完整的一份
+#   todo sync --since 1234 -o delta.sync.gz     # 之后：只有 1234 之后的变更
+#   todo sync --apply delta.sync.gz             # 在另一台机器上应用
+#
+# 同步是单向的（一台主机、若干副本），任务 ID 原样保留；两边都新增任务时 ID 会冲突，后应用的覆盖先写入的。
+# 文件是 gzip 压缩的 JSON Lines：第一行是文件头，中间每行一个变更 [task_id, 种类, row 或 null]，
+# 种类是 upsert / archive / delete（见 db.CHANGE_*），主机上归档的任务在副本上同样归档，而不是被删掉。
+# 最后一行是文件尾 {"until": 序号}。没有文件尾说明文件不完整，应用时整体回滚。
+
+import gzip
+import json
+import sys
+
+from . import db
+
+SYNC_FORMAT = 'todo-sync'
+SYNC_VERSION = 2
+
+
+def _open(path, mode):
+    """'-' 表示标准输入/输出"""
+    if path == '-':
+        stream = sys.stdin.buffer if 'r' in mode else sys.stdout.buffer
+        return gzip.open(stream, mode + 't', encoding='utf-8')
+    return gzip.open(path, mode + 't', encoding='utf-8')
+
+def export_changes(path, since=0):
+    """把 since 之后的变更写到 path，返回 (变更数量, 下次同步用的序号)"""
+    encode = json.JSONEncoder(ensure_ascii=False, separators=(',', ':')).encode
+    count = 0
+    until = since
+    with _open(path, 'w') as f:
+        f.write(encode({'format': SYNC_FORMAT, 'version': SYNC_VERSION,
+                        'since': since, 'columns': db.EXPORT_COLUMNS}) + '\n')
+        for batch in db.iter_changes(since):
+            f.write(''.join(encode([task_id, kind, row]) + '\n' for _, task_id, kind, row in batch))
+            count += len(batch)
+            until = batch[-1][0]
+        f.write(encode({'until': until}) + '\n')
+    return count, until
+
+_CHANGE_KINDS = (db.CHANGE_UPSERT, db.CHANGE_ARCHIVE, db.CHANGE_DELETE)
+
+
+def _read_changes(f, trailer):
+    """逐行产出 (task_id, kind, row)，读到文件尾时把它存进 trailer；文件不完整或内容不对时抛出 ValueError"""
+    for line in f:
+        item = json.loads(line)
+        if isinstance(item, dict):
+            trailer.update(item)
+            return
+        task_id, kind, row = item
+        if kind not in _CHANGE_KINDS:
+            raise ValueError(f"同步文件中有未知的变更种类 {kind!r}")
+        yield task_id, kind, None if row is None else tuple(row)
+    raise ValueError("同步文件不完整：缺少文件尾")
+
+def apply_file(path):
+    """应用 export_changes 写出的文件，返回 (写入数量, 归档数量, 删除数量, 文件对应的序号)"""
+    try:
+        with _open(path, 'r') as f:
+            try:
+                header = json.loads(f.readline())
+            except json.JSONDecodeError:
+                header = None
+            if not isinstance(header, dict) or header.get('format') != SYNC_FORMAT:
+                raise ValueError("不是 todo sync 导出的文件")
+            if header.get('version') != SYNC_VERSION or tuple(header.get('columns', ())) != db.EXPORT_COLUMNS:
+                raise ValueError("同步文件的版本与本程序不一致，请在两边使用相同版本的 todo")
+            trailer = {}
+            upserted, archived, deleted = db.apply_changes(_read_changes(f, trailer))
+    except EOFError:
+        # gzip 数据被截断；apply_changes 的事务已经回滚
+        raise ValueError("同步文件不完整：压缩数据被截断") from None
+    return upserted, archived, deleted, trailer['until']
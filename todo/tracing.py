@@ -0,0 +1,103 @@
+# todo/tracing.py
+# 耗时剖析：todo --profile FILE，看清一次按键到输出之间的时间花在了哪里
+#
+#   FILE 以 .json 结尾    Chrome trace-event 格式，用 chrome://tracing 或 https://ui.perfetto.dev 打开。
+#                         交互模式下每个菜单操作是一段 action，里面再分 input（等待输入）、db（数据库调用）、
+#                         render（输出）；每条 SQL 语句是 db 里面的一段 sql
+#   其他扩展名            cProfile 统计（如 session.prof），用 python -m pstats、snakeviz 或 flameprof 查看
+#
+# 结果在进程退出时写出。默认关闭，关闭时 span() 直接返回一个空的上下文管理器。
+
+import atexit
+import contextlib
+import os
+import sys
+import threading
+import time
+
+ENABLED = False
+_events = []
+_lock = threading.Lock()
+_path = None
+_profiler = None
+# 事件的时间戳从开启时算起，单位微秒
+_origin = 0.0
+_NULL_SPAN = contextlib.nullcontext()
+
+
+class _Span:
+    """一段时间区间，退出时记为一个 complete 事件（ph 为 X）"""
+    __slots__ = ('name', 'cat', 'args', 'start')
+
+    def __init__(self, name, cat, args):
+        self.name = name
+        self.cat = cat
+        self.args = args
+
+    def __enter__(self):
+        self.start = time.perf_counter()
+        return self
+
+    def __exit__(self, *exc):
+        record(self.name, self.cat, self.start, time.perf_counter() - self.start, self.args)
+        return False
+
+
+def span(name, cat, **args):
+    """with span('add', 'action'): ...；args 会显示在事件详情里"""
+    if not ENABLED:
+        return _NULL_SPAN
+    return _Span(name, cat, args)
+
+def call(cat, func, *args, **kwargs):
+    """在一段以函数名命名的 span 里调用 func，返回它的结果"""
+    if not ENABLED:
+        return func(*args, **kwargs)
+    with _Span(func.__name__, cat, None):
+        return func(*args, **kwargs)
+
+def record(name, cat, start, elapsed, args=None):
+    """记录一段已经结束的区间；start 是 time.perf_counter() 的读数，elapsed 单位为秒"""
+    event = {
+        'name': name, 'cat': cat, 'ph': 'X',
+        'ts': (start - _origin) * 1_000_000, 'dur': elapsed * 1_000_000,
+        'pid': os.getpid(), 'tid': threading.get_native_id(),
+    }
+    if args:
+        event['args'] = args
+    with _lock:
+        _events.append(event)
+
+def enable(path):
+    """开启剖析，结果在进程退出时写到 path；要在打开数据库连接之前调用，SQL 语句才会被记录"""
+    global ENABLED, _path, _profiler, _origin
+    _path = path
+    if path.lower().endswith('.json'):
+        from . import instrument
+        # SQL 语句的耗时由 instrument 的计时游标测量，再转成 sql 事件
+        instrument.enable()
+        _origin = time.perf_counter()
+        ENABLED = True
+    else:
+        import cProfile
+        _profiler = cProfile.Profile()
+        _profiler.enable()
+    atexit.register(finish)
+
+def finish():
+    """停止剖析并写出结果文件"""
+    global ENABLED, _profiler
+    if _profiler is not None:
+        _profiler.disable()
+        _profiler.dump_stats(_path)
+        _profiler = None
+    elif ENABLED:
+        ENABLED = False
+        import json
+        with _lock:
+            events = list(_events)
+        with open(_path, 'w', encoding='utf-8') as f:
+            json.dump({'traceEvents': events, 'displayTimeUnit': 'ms'}, f, ensure_ascii=False)
+    else:
+        return
+    sys.stderr.write(f"剖析结果已写到 {_path}\n")
@@ -0,0 +1,127 @@
+# todo/transfer.py
+# 任务数据与外部文件（CSV / JSONL / Parquet）之间的转换，全部按行或按批流式处理
+
+import csv
+import json
+import sys
+
+IMPORT_FORMATS = ['csv', 'jsonl']
+# parquet 需要安装 pyarrow，只在真正导出时才导入
+EXPORT_FORMATS = ['csv', 'jsonl', 'parquet']
+# 导出文件的写缓冲大小（字节）
+WRITE_BUFFER = 1 << 20
+
+
+def guess_format(path, formats=IMPORT_FORMATS):
+    """根据文件扩展名推断格式，推断不出来时返回 None"""
+    for fmt in formats:
+        if path.lower().endswith('.' + fmt):
+            return fmt
+    return None
+
+def _open_input(path):
+    """'-' 表示从标准输入读取"""
+    if path == '-':
+        return sys.stdin
+    return open(path, 'r', encoding='utf-8', newline='')
+
+def read_csv(f):
+    """逐行读取 CSV，需要表头中有 content 列，deadline 列可选"""
+    for row in csv.DictReader(f):
+        content = row.get('content')
+        if content:
+            yield content, row.get('deadline') or None
+
+def read_jsonl(f):
+    """逐行读取 JSONL，每行一个对象，至少包含 content 字段"""
+    for line_no, line in enumerate(f, 1):
+        line = line.strip()
+        if not line:
+            continue
+        try:
+            item = json.loads(line)
+        except json.JSONDecodeError as e:
+            raise ValueError(f"第 {line_no} 行不是合法的 JSON: {e}") from e
+        content = item.get('content')
+        if content:
+            yield content, item.get('deadline') or None
+
+def iter_import(path, fmt):
+    """
+    打开 path 并按 fmt 逐条产出 (content, deadline)。
+    生成器结束时才会关闭文件，适合直接交给 db.add_todos 流式写入。
+    """
+    reader = read_csv if fmt == 'csv' else read_jsonl
+    f = _open_input(path)
+    try:
+        yield from reader(f)
+    finally:
+        if f is not sys.stdin:
+            f.close()
+
+
+def _open_output(path):
+    """'-' 表示写到标准输出；文件用较大的写缓冲，导出速度取决于磁盘而不是系统调用次数"""
+    if path == '-':
+        return sys.stdout
+    return open(path, 'w', encoding='utf-8', newline='', buffering=WRITE_BUFFER)
+
+def write_csv(f, columns, batches):
+    """第一行是表头，之后每行一个任务；空值写成空字符串"""
+    writer = csv.writer(f)
+    writer.writerow(columns)
+    count = 0
+    for rows in batches:
+        writer.writerows(rows)
+        count += len(rows)
+    return count
+
+def write_jsonl(f, columns, batches):
+    """
+    每行一个 JSON 对象，字段与 columns 一致。todo import 只读回 content 和 deadline，
+    作为新任务导入（新的 ID、未完成）；要原样恢复全部字段请用 todo backup 或 todo sync
+    """
+    encode = json.JSONEncoder(ensure_ascii=False).encode
+    count = 0
+    for rows in batches:
+        f.write(''.join(encode(dict(zip(columns, row))) + '\n' for row in rows))
+        count += len(rows)
+    return count
+
+def write_parquet(path, columns, batches):
+    """每批写成一个 row group，内存里最多同时有一批"""
+    try:
+        import pyarrow as pa
+        import pyarrow.parquet as pq
+    except ImportError:
+        raise ValueError("导出 parquet 需要先安装 pyarrow（pip install pyarrow）") from None
+    schema = pa.schema([
+        (name, pa.int64() if name in ('task_id', 'is_done') else pa.string())
+        for name in columns
+    ])
+    count = 0
+    with pq.ParquetWriter(path, schema) as writer:
+        for rows in batches:
+            arrays = [pa.array(values, type=field.type) for values, field in zip(zip(*rows), schema)]
+            writer.write_batch(pa.record_batch(arrays, schema=schema))
+            count += len(rows)
+    return count
+
+def export(path, fmt, columns, batches):
+    """
+    把 batches（每批是若干行元组，列顺序为 columns）写到 path，返回导出的行数。
+    一般传入 db.iter_export_batches()，全程不会把整张表读进内存。
+    """
+    if fmt == 'parquet':
+        if path == '-':
+            raise ValueError("parquet 不能写到标准输出，请指定文件名")
+        return write_parquet(path, columns, batches)
+    writer = write_csv if fmt == 'csv' else write_jsonl
+    f = _open_output(path)
+    try:
+        return writer(f, columns, batches)
+    finally:
+        if f is sys.stdout:
+            f.flush()
+        else:
+            f.close()
@@ -2,23 +2,54 @@
 
 # 从我们的 db 模块中导入所有需要的函数
 from . import db
+from . import tracing
+from .render import format_task, render_tasks
+import itertools
 import time
 
+# 每次操作之后暂停的秒数，让用户可以看清操作结果；todo --no-pause 时为 0
+PAUSE_SECONDS = 2
+# 一次批量选择最多包含的任务数量，防止 1-999999999 这样的输入生成巨大的列表
+MAX_SELECTION = 100000
+
+def parse_selection(text):
+    """
+    把 '1-20,25,40' 这样的选择解析成去重并排序的任务 ID 列表，逗号和空格都可以作分隔符。
+    格式不对、范围倒置或超过 MAX_SELECTION 个时抛出 ValueError。
+    """
+    ids = set()
+    for part in text.replace(',', ' ').split():
+        first, sep, last = part.partition('-')
+        try:
+            start = int(first)
+            end = int(last) if sep else start
+        except ValueError:
+            raise ValueError(f"无法识别 {part!r}，请输入 ID 或 ID 范围，例如 1-20,25") from None
+        if start > end:
+            raise ValueError(f"范围 {part!r} 的起点大于终点")
+        if end - start + 1 + len(ids) > MAX_SELECTION:
+            raise ValueError(f"一次最多选择 {MAX_SELECTION} 个任务")
+        ids.update(range(start, end + 1))
+    if not ids:
+        raise ValueError("没有输入任务 ID")
+    return sorted(ids)
+
+def _input(prompt):
+    """读取一行输入；剖析时等待输入的时间单独记为 input，不算进数据库和输出"""
+    with tracing.span('input', 'input'):
+        return input(prompt)
+
 def _print_tasks(tasks):
-    """美观地打印任务列表的辅助函数"""
-    if not tasks:
+    """美观地打印任务列表的辅助函数，tasks 可以是列表或迭代器"""
+    tasks = iter(tasks)
+    first = next(tasks, None)
+    if first is None:
         print("太棒了！当前没有待办事项。")
         return
 
     print("\n--- 任务列表 ---")
-    for task in tasks:
-        # 根据 is_done 状态显示不同的标记
-        status_icon = "[x]" if task['is_done'] else "[ ]"
-        
-        # 如果有截止日期，就格式化显示
-        deadline_str = f" (截止日期: {task['deadline']})" if task['deadline'] else ""
-        
-        print(f"{status_icon} ID: {task['task_id']:<3} | {task['content']}{deadline_str}")
+    # 表头和表尾各占一行
+    render_tasks(itertools.chain([first], tasks), reserved_lines=2)
     print("------------------")
 
 
@@ -27,71 +58,117 @@ def print_menu():
     print("\n===== 待办事项列表 =====")
     print("1. 查看所有任务")
     print("2. 添加新任务")
-    print("3. 标记/取消标记任务")
-    print("4. 删除任务")
+    print("3. 标记/取消标记任务（可批量，如 3 1-20,25,40）")
+    print("4. 删除任务（可批量，如 4 1-20,25,40）")
     print("5. 退出")
     print("========================")
 
 
-def main_loop():
-    """程序的主循环"""
+def _list_tasks(_selection=''):
+    print("\n正在获取所有任务...")
+    all_tasks = tracing.call('db', db.get_all_todos)
+    tracing.call('render', _print_tasks, all_tasks)
+
+def _add_task(_selection=''):
+    print("\n--- 添加新任务 ---")
+    content = _input("请输入任务内容: ")
+    if not content:
+        print("错误：内容不能为空！")
+        return False
+
+    deadline = _input("请输入截止日期 (格式: YYYY-MM-DD HH:MM:SS)，或直接回车跳过: ")
+    try:
+        # 直接回车时得到 None；'2026-5-1' 这类写法会被统一成标准格式
+        deadline = db.normalize_timestamp(deadline)
+    except ValueError as e:
+        print(f"错误：{e}")
+        return False
+
+    task = tracing.call('db', db.add_todo, content, deadline)
+    print("任务已成功添加！")
+    print(f"+ {format_task(task)}")
+
+def _report_missing(requested, count):
+    """批量操作后提示有多少个 ID 没有对应的任务"""
+    if count < requested:
+        print(f"有 {requested - count} 个 ID 没有找到对应的任务。")
+
+def _toggle_task(selection=''):
+    print("\n--- 标记任务 ---")
+    try:
+        task_ids = parse_selection(selection or _input("请输入要标记的任务ID（可输入 1-20,25 批量标记）: "))
+        status = int(_input("输入 '1' 标记为完成, '0' 标记为未完成: "))
+        if status not in [0, 1]:
+            raise ValueError("状态只能是 0 或 1")
+        if len(task_ids) > 1:
+            # 所有任务在一个事务里更新
+            count = tracing.call('db', db.set_status_many, task_ids, status)
+            _report_missing(len(task_ids), count)
+            return
+        task_id = task_ids[0]
+        task = tracing.call('db', db.update_todo_status, task_id, status)
+        if task is None:
+            print(f"没有找到 ID 为 {task_id} 的任务。")
+        else:
+            print("状态更新成功！")
+            print(f"~ {format_task(task)}")
+    except ValueError as e:
+        print(f"输入无效，请确保ID和状态都是正确的数字。错误: {e}")
+
+def _delete_task(selection=''):
+    print("\n--- 删除任务 ---")
+    try:
+        task_ids = parse_selection(selection or _input("请输入要删除的任务ID（可输入 1-20,25 批量删除）: "))
+        if len(task_ids) > 1:
+            answer = _input(f"确定要删除这 {len(task_ids)} 个任务吗？(y/N): ")
+            if answer.strip().lower() not in ('y', 'yes'):
+                print("已取消。")
+                return
+            # 所有任务在一个事务里删除
+            count = tracing.call('db', db.delete_many, task_ids)
+            _report_missing(len(task_ids), count)
+            return
+        task_id = task_ids[0]
+        task = tracing.call('db', db.delete_todo, task_id)
+        if task is None:
+            print(f"没有找到 ID 为 {task_id} 的任务。")
+        else:
+            print("任务删除成功！")
+            print(f"- {format_task(task)}")
+    except ValueError as e:
+        print(f"输入无效，请输入正确的任务ID数字。错误: {e}")
+
+# 菜单选项 -> (剖析时的 action 名称, 处理函数)。处理函数的参数是选项后面的文本（'3 1-20,25' 中的 '1-20,25'），
+# 用不到时忽略；返回 False 表示输入有误，不暂停直接回到菜单
+ACTIONS = {
+    '1': ('list', _list_tasks),
+    '2': ('add', _add_task),
+    '3': ('status', _toggle_task),
+    '4': ('delete', _delete_task),
+}
+
+
+def main_loop(pause=PAUSE_SECONDS):
+    """程序的主循环；pause 是每次操作之后暂停的秒数"""
+    # 交互模式下反复查看同一张表，用缓存代替每次重新查询
+    db.enable_task_cache()
     while True:
-        print_menu()
-        choice = input("请输入你的选择 (1-5): ")
-
-        if choice == '1':
-            print("\n正在获取所有任务...")
-            all_tasks = db.get_all_todos()
-            _print_tasks(all_tasks)
-
-        elif choice == '2':
-            print("\n--- 添加新任务 ---")
-            content = input("请输入任务内容: ")
-            if not content:
-                print("错误：内容不能为空！")
-                continue
-
-            deadline = input("请输入截止日期 (格式: YYYY-MM-DD HH:MM:SS)，或直接回车跳过: ")
-            if not deadline:
-                deadline = None # 如果用户直接回车，就设置为 None
-            
-            db.add_todo(content, deadline)
-            print("任务已成功添加！")
-
-        elif choice == '3':
-            print("\n--- 标记任务 ---")
-            try:
-                task_id = int(input("请输入要标记的任务ID: "))
-                status = int(input("输入 '1' 标记为完成, '0' 标记为未完成: "))
-                if status not in [0, 1]:
-                    raise ValueError("状态只能是 0 或 1")
-                db.update_todo_status(task_id, status)
-                print("状态更新成功！")
-            except ValueError as e:
-                print(f"输入无效，请确保ID和状态都是正确的数字。错误: {e}")
-
-        elif choice == '4':
-            print("\n--- 删除任务 ---")
-            try:
-                task_id = int(input("请输入要删除的任务ID: "))
-                db.delete_todo(task_id)
-                print("任务删除成功！")
-            except ValueError:
-                print("输入无效，请输入正确的任务ID数字。")
-
-        elif choice == '5':
+        tracing.call('render', print_menu)
+        choice, _, selection = _input("请输入你的选择 (1-5): ").strip().partition(' ')
+
+        if choice == '5':
             print("感谢使用，再见！")
             break
-        else:
+        action = ACTIONS.get(choice)
+        if action is None:
             print("无效输入，请重新输入。")
-        
-        # 在很多操作后，重新显示列表是一个好习惯
-        if choice in ['2', '3', '4']:
-            print("\n更新后的任务列表：")
-            all_tasks = db.get_all_todos()
-            _print_tasks(all_tasks)
+        else:
+            name, handler = action
+            with tracing.span(name, 'action'):
+                if handler(selection.strip()) is False:
+                    continue
 
         # 暂停一下，让用户可以看清操作结果
-        time.sleep(2)
-
-
+        if pause:
+            with tracing.span('pause', 'pause'):
+                time.sleep(pause)
@@ -0,0 +1,135 @@
+# todo/writer.py
+# 可选的后台写线程：写操作放进队列，由一个线程把短时间内到达的写操作合并成一次提交（group commit）
+#
+#     future = writer.get_writer().submit(db.update_todo_status, 3, 1)
+#     task = future.result()   # 等到所在的事务提交之后才返回
+
+import atexit
+import queue
+import threading
+import time
+from concurrent.futures import Future
+
+from . import config
+from . import db
+
+# 收到第一个写操作后，再等待这么多毫秒收集后续的写操作
+DEFAULT_WINDOW_MS = 5
+# 一个事务最多合并的写操作数量
+DEFAULT_MAX_BATCH = 256
+
+_STOP = object()
+
+
+class GroupCommitWriter:
+    """
+    单个写线程。调用方 submit 后立即拿到 Future，不必等待磁盘同步；
+    同一批里的写操作共用一个事务，每个操作各自一个 SAVEPOINT，
+    某个操作失败只会让它自己的 Future 得到异常，不影响同批的其他操作。
+    """
+
+    def __init__(self, window_ms=None, max_batch=None):
+        if window_ms is None:
+            window_ms = config.get_int('writer', 'window_ms', DEFAULT_WINDOW_MS)
+        if max_batch is None:
+            max_batch = config.get_int('writer', 'max_batch', DEFAULT_MAX_BATCH)
+        self.window = window_ms / 1000
+        self.max_batch = max_batch
+        self._queue = queue.Queue()
+        self._closed = False
+        self._thread = threading.Thread(target=self._run, name='todo-writer', daemon=True)
+        self._thread.start()
+
+    def submit(self, func, *args, **kwargs):
+        """把一次写操作（通常是 db 模块的某个写函数）放进队列，返回它的 Future"""
+        if self._closed:
+            raise RuntimeError("写线程已经关闭")
+        future = Future()
+        self._queue.put((future, func, args, kwargs))
+        return future
+
+    def flush(self):
+        """等待此前提交的所有写操作完成"""
+        self.submit(lambda: None).result()
+
+    def close(self):
+        """处理完队列里剩下的写操作后结束写线程"""
+        if self._closed:
+            return
+        self._closed = True
+        self._queue.put(_STOP)
+        self._thread.join()
+
+    def _collect(self, first):
+        """从第一个写操作开始，在时间窗口内尽量多收集几个，返回 (batch, 是否收到结束信号)"""
+        batch = [first]
+        deadline = time.monotonic() + self.window
+        while len(batch) < self.max_batch:
+            timeout = deadline - time.monotonic()
+            if timeout <= 0:
+                break
+            try:
+                item = self._queue.get(timeout=timeout)
+            except queue.Empty:
+                break
+            if item is _STOP:
+                return batch, True
+            batch.append(item)
+        return batch, False
+
+    def _commit(self, batch):
+        """在一个事务里执行整批写操作，提交成功后才设置各个 Future 的结果"""
+        outcomes = []
+        try:
+            with db.transaction():
+                for future, func, args, kwargs in batch:
+                    if not future.set_running_or_notify_cancel():
+                        outcomes.append(None)
+                        continue
+                    try:
+                        with db.transaction():
+                            outcomes.append((True, func(*args, **kwargs)))
+                    except Exception as e:
+                        outcomes.append((False, e))
+        except Exception as e:
+            # 提交本身失败了：整批都没有生效。观察者的通知在提交之后才发出，这时已经随事务丢掉
+            for future, _, _, _ in batch:
+                if future.running():
+                    future.set_exception(e)
+            return
+
+        for (future, _, _, _), outcome in zip(batch, outcomes):
+            if outcome is None:
+                continue
+            ok, value = outcome
+            if ok:
+                future.set_result(value)
+            else:
+                future.set_exception(value)
+
+    def _run(self):
+        try:
+            while True:
+                item = self._queue.get()
+                if item is _STOP:
+                    return
+                batch, stop = self._collect(item)
+                self._commit(batch)
+                if stop:
+                    return
+        finally:
+            db.release_db()
+
+
+_writer = None
+_writer_lock = threading.Lock()
+
+
+def get_writer():
+    """返回进程共用的写线程，第一次调用时启动，进程退出前自动处理完剩余的写操作"""
+    global _writer
+    with _writer_lock:
+        if _writer is None:
+            _writer = GroupCommitWriter()
+            atexit.register(_writer.close)
+        return _writer